@@ -0,0 +1,287 @@
+/*!
+  @file       genealogy.hpp
+  @brief      Deterministic synthetic family tree generator for benchmarks
+
+  @author     Robert McInnis
+  @date       september 21, 2016
+  @par        copyright (c) 2016 Solid ICE Technologies, Inc.  All rights reserved.
+
+  Distributed under the Boost Software License, Version 1.0. (See accompanying
+  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+*/
+#ifndef GENEALOGY_HPP
+#define GENEALOGY_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <boost/relations/entity.hpp>
+#include <boost/relations/reciprocal.hpp>
+#include <boost/relations/schema.hpp>
+
+namespace boost { namespace relations {
+
+// class:  SplitMix
+// desc:   splitmix64; small, fast and identical on every platform, so the
+//         same seed always yields the same population
+//
+class SplitMix
+{
+  private :
+    uint64_t       _state ;
+
+  public  :
+    explicit       SplitMix( uint64_t seed ) : _state( seed ) {}
+
+    uint64_t       next()
+                   {
+                     uint64_t  z = (_state += 0x9E3779B97F4A7C15ull) ;
+                     z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull ;
+                     z = (z ^ (z >> 27)) * 0x94D049BB133111EBull ;
+                     return z ^ (z >> 31) ;
+                   }
+    uint32_t       below( uint32_t n ) { return (uint32_t)(((next() >> 32) * n) >> 32) ; }
+} ; // class SplitMix
+
+// struct: GenealogyConfig
+// desc:   shape of the generated population
+//
+struct GenealogyConfig
+{
+  uint64_t         seed ;
+  uint32_t         people ;        // total entities
+  uint32_t         founders ;      // first generation of each cohort; 0 == people / 64 (at least 2)
+  uint32_t         generations ;   // generations per cohort before a new one starts; 0 == unlimited
+  double           marriage_rate ; // share of the smaller gender that marries
+  double           fan_out ;       // mean children per couple
+  uint32_t         surnames ;      // distinct last names among founders
+
+                   GenealogyConfig()
+                   : seed( 1 ), people( 1000 ), founders( 0 ), generations( 8 ),
+                     marriage_rate( 0.7 ), fan_out( 2.2 ), surnames( 500 ) {}
+} ; // struct GenealogyConfig
+
+// struct: Person
+// desc:   one generated entity
+//
+struct Person
+{
+  uint32_t         id ;
+  bool             male ;
+  uint32_t         surname ;
+
+                   Person( uint32_t id_, bool male_, uint32_t surname_ ) : id( id_ ), male( male_ ), surname( surname_ ) {}
+} ; // struct Person
+
+typedef std::vector<Person>            PersonVec ;
+typedef std::vector<Person>::iterator  PersonVec_iter ;
+
+// class:  GenealogyGenerator
+// desc:   grows family trees a generation at a time: the people of one
+//         generation are shuffled, a share of them marry, and each couple
+//         has 0 .. 2 * fan_out children who form the next generation.  when
+//         a cohort dies out or reaches 'generations', a new set of founders
+//         starts the next one.  only the current generation is held, so
+//         any population size streams through in bounded memory.  ids run
+//         1 .. people in birth order
+//
+class GenealogyGenerator
+{
+  private :
+    GenealogyConfig   _cfg ;
+    SplitMix          _rng ;
+    uint32_t          _next_id ;
+    RelationType      _spouse ;
+    RelationType      _son ;
+    RelationType      _daughter ;
+
+    Person            born( uint32_t surname )
+                      {
+                        return Person( _next_id++, _rng.next() & 1, surname ) ;
+                      }
+
+  public  :
+    explicit          GenealogyGenerator( const GenealogyConfig &cfg_ ) : _cfg( cfg_ ), _rng( cfg_.seed ), _next_id( 1 ),
+                      _spouse( "spouse" ), _son( "son" ), _daughter( "daughter" ) {}
+
+    // on_person( const Person & ) for each entity, then on_edge( child,
+    // son / daughter, parent ) and on_edge( husband, spouse, wife ) as
+    // their generation is formed.  every person is reported before any edge
+    // that names them
+    template <typename OnPerson, typename OnEdge>
+    void              generate( OnPerson on_person, OnEdge on_edge )
+                      {
+                        uint32_t   founders = _cfg.founders ? _cfg.founders : std::max( 2u, _cfg.people / 64 ) ;
+                        uint32_t   last     = _cfg.people ;
+                        PersonVec  current ;
+                        PersonVec  men ;
+                        PersonVec  women ;
+                        PersonVec  next ;
+                        uint32_t   depth    = 0 ;
+
+                        while (_next_id <= last)
+                        {
+                          if (current.empty() || (_cfg.generations != 0 && depth == _cfg.generations))
+                          {
+                            current.clear() ;
+                            for (uint32_t i = 0; i < founders && _next_id <= last; i++)
+                            {
+                              current.push_back( born( _rng.below( _cfg.surnames ))) ;
+                              on_person( current.back() ) ;
+                            }
+                            depth = 0 ;
+                          }
+
+                          men.clear() ;
+                          women.clear() ;
+                          for (PersonVec_iter it = current.begin(); it != current.end(); it++)
+                            ((*it).male ? men : women).push_back( *it ) ;
+                          shuffle( men ) ;
+                          shuffle( women ) ;
+
+                          size_t  couples = (size_t)(std::min( men.size(), women.size() ) * _cfg.marriage_rate) ;
+                          next.clear() ;
+                          for (size_t c = 0; c < couples && _next_id <= last; c++)
+                          {
+                            Person  &father = men[c] ;
+                            Person  &mother = women[c] ;
+                            on_edge( father.id, _spouse, mother.id ) ;
+
+                            uint32_t  kids = _rng.below( (uint32_t)(2 * _cfg.fan_out) + 1 ) ;
+                            for (uint32_t k = 0; k < kids && _next_id <= last; k++)
+                            {
+                              Person  child = born( father.surname ) ;
+                              on_person( child ) ;
+                              on_edge( child.id, child.male ? _son : _daughter, father.id ) ;
+                              on_edge( child.id, child.male ? _son : _daughter, mother.id ) ;
+                              next.push_back( child ) ;
+                            }
+                          }
+                          current.swap( next ) ;
+                          depth++ ;
+                        }
+                      }
+
+  private :
+    void              shuffle( PersonVec &v )
+                      {
+                        for (size_t i = v.size(); i > 1; i--)
+                          std::swap( v[i - 1], v[_rng.below( (uint32_t)i )] ) ;
+                      }
+} ; // class GenealogyGenerator
+
+// func:   genealogy_rules
+// desc:   the reciprocal rules generated populations rely on
+//
+inline void genealogy_rules( ReciprocalMgr &rules )
+{
+  rules.set( "spouse"  , "spouse" ) ;
+  rules.set( "son"     , "parent" ) ;
+  rules.set( "son"     , "father"   , "gender", "male" ) ;
+  rules.set( "son"     , "mother"   , "gender", "female" ) ;
+  rules.set( "daughter", "parent" ) ;
+  rules.set( "daughter", "father"   , "gender", "male" ) ;
+  rules.set( "daughter", "mother"   , "gender", "female" ) ;
+  rules.set( "parent"  , "child" ) ;
+  rules.set( "father"  , "son"      , "gender", "male" ) ;
+  rules.set( "father"  , "daughter" , "gender", "female" ) ;
+  rules.set( "mother"  , "son"      , "gender", "male" ) ;
+  rules.set( "mother"  , "daughter" , "gender", "female" ) ;
+} // :: genealogy_rules
+
+// namespace: kin
+// desc:   genealogy_rules() as a typed schema
+//
+namespace kin {
+
+BOOST_RELATIONS_NAME( Gender, "gender" ) ;
+BOOST_RELATIONS_NAME( Male  , "male" ) ;
+BOOST_RELATIONS_NAME( Female, "female" ) ;
+
+typedef When<Gender, Male>    IsMale ;
+typedef When<Gender, Female>  IsFemale ;
+
+struct Spouse ;
+struct Son ;
+struct Daughter ;
+struct Parent ;
+struct Child ;
+struct Father ;
+struct Mother ;
+
+struct Spouse   : Relation< Spouse  , Rule<Spouse> >                                              { static const char *name() { return "spouse" ; } } ;
+struct Son      : Relation< Son     , Rule<Parent>, Rule<Father, IsMale>, Rule<Mother, IsFemale> > { static const char *name() { return "son" ; } } ;
+struct Daughter : Relation< Daughter, Rule<Parent>, Rule<Father, IsMale>, Rule<Mother, IsFemale> > { static const char *name() { return "daughter" ; } } ;
+struct Parent   : Relation< Parent  , Rule<Child> >                                               { static const char *name() { return "parent" ; } } ;
+struct Child    : Relation< Child >                                                               { static const char *name() { return "child" ; } } ;
+struct Father   : Relation< Father  , Rule<Son, IsMale>, Rule<Daughter, IsFemale> >               { static const char *name() { return "father" ; } } ;
+struct Mother   : Relation< Mother  , Rule<Son, IsMale>, Rule<Daughter, IsFemale> >               { static const char *name() { return "mother" ; } } ;
+
+} // namespace kin
+
+// func:   genealogy_link
+// desc:   the generator's edges through the typed schema; the same links
+//         ReciprocalMgr::link_with_reciprocals makes under genealogy_rules()
+//
+inline void genealogy_link( EntityMgr &mgr, const EdgeVec &edges )
+{
+  const RelationType  son( kin::Son::type() ), daughter( kin::Daughter::type() ) ;
+
+  for (EdgeVec::const_iterator it = edges.begin(); it != edges.end(); it++)
+  {
+    Entity  &from = mgr.get( (*it).from ) ;
+    Entity  &to   = mgr.get( (*it).to ) ;
+
+    if ((*it).type == son)
+      link<kin::Son>( from, to ) ;
+    else if ((*it).type == daughter)
+      link<kin::Daughter>( from, to ) ;
+    else
+      link<kin::Spouse>( from, to ) ;
+  }
+} // :: genealogy_link
+
+// struct: Genealogy
+// desc:   a generated population held in memory, ready to be ingested
+//
+struct Genealogy
+{
+  PersonVec        people ;
+  EdgeVec          edges ;
+
+  void             generate( const GenealogyConfig &cfg )
+                   {
+                     GenealogyGenerator  gen( cfg ) ;
+
+                     people.clear() ;
+                     edges.clear() ;
+                     people.reserve( cfg.people ) ;
+                     gen.generate( [&]( const Person &p ) { people.push_back( p ) ; },
+                                   [&]( uint32_t from, RelationType type, uint32_t to ) { edges.push_back( Edge( from, type, to )) ; } ) ;
+                   }
+
+  // meta only; edges are applied separately so they can be timed
+  void             load_people( EntityMgr &mgr ) const
+                   {
+                     static const MetaKey  firstname( "firstname" ), lastname( "lastname" ), gender( "gender" ) ;
+                     static const std::string  male( "male" ), female( "female" ) ;
+                     char  buf[16] ;
+
+                     for (PersonVec::const_iterator it = people.begin(); it != people.end(); it++)
+                     {
+                       Entity  &e = mgr.get( (*it).id ) ;
+                       snprintf( buf, sizeof(buf), "p%u", (*it).id ) ;
+                       e.meta( firstname, buf ) ;
+                       snprintf( buf, sizeof(buf), "s%u", (*it).surname ) ;
+                       e.meta( lastname, buf ) ;
+                       e.meta( gender, (*it).male ? male : female ) ;
+                     }
+                   }
+} ; // struct Genealogy
+
+}} ; // namespace
+
+#endif
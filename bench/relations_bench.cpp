@@ -0,0 +1,402 @@
+/*!
+  @file       relations_bench.cpp
+  @brief      hot path benchmarks for boost::relations over generated families
+
+  @author     Robert McInnis
+  @date       september 21, 2016
+  @par        copyright (c) 2016 Solid ICE Technologies, Inc.  All rights reserved.
+
+  Distributed under the Boost Software License, Version 1.0. (See accompanying
+  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+  options, ahead of the usual --benchmark_* flags:
+
+    --people=1000,100000   population sizes to run (1K .. 100M)
+    --fanout=2.2           mean children per couple
+    --marriage=0.7         share of the smaller gender that marries
+    --generations=8        generations per family cohort (0 == unlimited)
+    --depth=4              find_relations depth limit
+    --seed=1               generator seed
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <boost/relations/change_log.hpp>
+#include <boost/relations/entity.hpp>
+#include <boost/relations/reciprocal.hpp>
+#include <boost/relations/schema.hpp>
+
+#include "genealogy.hpp"
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace boost { namespace relations {
+
+GenealogyConfig   config ;
+uint32_t          depth = 4 ;
+
+// bytes currently allocated from the heap; 0 where the C library can't say
+int64_t heap_live()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+  struct mallinfo2  mi = mallinfo2() ;
+  return (int64_t)(mi.uordblks + mi.hblkhd) ;
+#else
+  return 0 ;
+#endif
+} // :: heap_live
+
+// struct: Population
+// desc:   a generated family ingested once per size and shared by the
+//         read-only benchmarks
+//
+struct Population
+{
+  Genealogy        family ;
+  ReciprocalMgr    rules ;
+  EntityMgr        mgr ;
+
+                   Population( uint32_t people )
+                   {
+                     GenealogyConfig  cfg = config ;
+                     cfg.people = people ;
+                     family.generate( cfg ) ;
+                     genealogy_rules( rules ) ;
+                     family.load_people( mgr ) ;
+                     rules.link_with_reciprocals( mgr, family.edges ) ;
+                   }
+} ; // struct Population
+
+Population &population( uint32_t people )
+{
+  static std::map< uint32_t, std::unique_ptr<Population> >  built ;
+
+  std::unique_ptr<Population>  &p = built[people] ;
+  if (!p)
+    p.reset( new Population( people )) ;
+  return *p ;
+} // :: population
+
+typedef std::chrono::steady_clock  Clock ;
+
+// p50 / p90 / p99 / max of per-query latencies, in microseconds
+void report_latency( benchmark::State &state, std::vector<double> &ns )
+{
+  if (ns.empty())
+    return ;
+  std::sort( ns.begin(), ns.end() ) ;
+  state.counters["p50_us"] = ns[ns.size() * 50 / 100] / 1000.0 ;
+  state.counters["p90_us"] = ns[ns.size() * 90 / 100] / 1000.0 ;
+  state.counters["p99_us"] = ns[ns.size() * 99 / 100] / 1000.0 ;
+  state.counters["max_us"] = ns.back() / 1000.0 ;
+} // :: report_latency
+
+//-----------------------------------------------------------------------------
+// benchmarks; state.range( 0 ) is the population size
+//
+
+// meta is loaded untimed; the timed part is apply_reciprocals over every edge
+void ingest( benchmark::State &state )
+{
+  uint32_t     people = (uint32_t)state.range( 0 ) ;
+  Population  &pop    = population( people ) ;
+  int64_t      bytes  = 0 ;
+
+  for (auto _ : state)
+  {
+    state.PauseTiming() ;
+    std::unique_ptr<EntityMgr>  mgr( new EntityMgr() ) ;
+    int64_t  before = heap_live() ;
+    pop.family.load_people( *mgr ) ;
+    state.ResumeTiming() ;
+
+    pop.rules.link_with_reciprocals( *mgr, pop.family.edges ) ;
+
+    state.PauseTiming() ;
+    bytes = heap_live() - before ;
+    mgr.reset() ;
+    state.ResumeTiming() ;
+  }
+  state.SetItemsProcessed( state.iterations() * (int64_t)pop.family.edges.size() ) ;
+  state.counters["edges"]        = (double)pop.family.edges.size() ;
+  state.counters["bytes/entity"] = (double)bytes / people ;
+} // :: ingest
+
+// ingest, through the typed schema instead of the rule tables
+void ingest_typed( benchmark::State &state )
+{
+  uint32_t     people = (uint32_t)state.range( 0 ) ;
+  Population  &pop    = population( people ) ;
+
+  for (auto _ : state)
+  {
+    state.PauseTiming() ;
+    std::unique_ptr<EntityMgr>  mgr( new EntityMgr() ) ;
+    pop.family.load_people( *mgr ) ;
+    state.ResumeTiming() ;
+
+    genealogy_link( *mgr, pop.family.edges ) ;
+
+    state.PauseTiming() ;
+    mgr.reset() ;
+    state.ResumeTiming() ;
+  }
+  state.SetItemsProcessed( state.iterations() * (int64_t)pop.family.edges.size() ) ;
+} // :: ingest_typed
+
+const char *log_path = "relations_bench.log" ;
+
+// ingest with a change log attached and one commit at the end; bytes/edge
+// is the log's size over the edges applied (meta records included)
+void ingest_logged( benchmark::State &state )
+{
+  uint32_t     people = (uint32_t)state.range( 0 ) ;
+  Population  &pop    = population( people ) ;
+  uint64_t     bytes  = 0 ;
+
+  for (auto _ : state)
+  {
+    state.PauseTiming() ;
+    std::unique_ptr<EntityMgr>  mgr( new EntityMgr() ) ;
+    ChangeLog                   log ;
+    log.create( log_path, 0 ) ;
+    (*mgr).change_log( &log ) ;
+    pop.family.load_people( *mgr ) ;
+    state.ResumeTiming() ;
+
+    pop.rules.link_with_reciprocals( *mgr, pop.family.edges ) ;
+    log.commit() ;
+
+    state.PauseTiming() ;
+    bytes = log.size() ;
+    (*mgr).change_log( nullptr ) ;
+    mgr.reset() ;
+    state.ResumeTiming() ;
+  }
+  std::remove( log_path ) ;
+  state.SetItemsProcessed( state.iterations() * (int64_t)pop.family.edges.size() ) ;
+  state.counters["bytes/edge"] = (double)bytes / (double)pop.family.edges.size() ;
+} // :: ingest_logged
+
+// rebuilding the population from a log of its whole ingest
+void replay( benchmark::State &state )
+{
+  uint32_t     people = (uint32_t)state.range( 0 ) ;
+  Population  &pop    = population( people ) ;
+  LogInfo      info ;
+
+  {
+    EntityMgr  mgr ;
+    ChangeLog  log ;
+    log.create( log_path, 0 ) ;
+    mgr.change_log( &log ) ;
+    pop.family.load_people( mgr ) ;
+    pop.rules.link_with_reciprocals( mgr, pop.family.edges ) ;
+    mgr.change_log( nullptr ) ;
+  }
+  for (auto _ : state)
+  {
+    EntityMgr  mgr ;
+    ChangeLog::replay( log_path, mgr, info ) ;
+
+    state.PauseTiming() ;
+    mgr.clear() ;
+    state.ResumeTiming() ;
+  }
+  std::remove( log_path ) ;
+  state.SetItemsProcessed( state.iterations() * (int64_t)info.records ) ;
+  state.counters["MB"] = (double)info.bytes / (1 << 20) ;
+} // :: replay
+
+void get( benchmark::State &state )
+{
+  uint32_t     people = (uint32_t)state.range( 0 ) ;
+  Population  &pop    = population( people ) ;
+  SplitMix     rng( 7 ) ;
+
+  for (auto _ : state)
+    benchmark::DoNotOptimize( &pop.mgr.get( rng.below( people ) + 1 )) ;
+  state.SetItemsProcessed( state.iterations() ) ;
+} // :: get
+
+// raw Entity::link on random pairs under a relation nothing else uses
+void link( benchmark::State &state )
+{
+  uint32_t      people = (uint32_t)state.range( 0 ) ;
+  Population   &pop    = population( people ) ;
+  RelationType  knows( "knows" ) ;
+  SplitMix      rng( 11 ) ;
+
+  for (auto _ : state)
+    pop.mgr.get( rng.below( people ) + 1 ).link( knows, pop.mgr.get( rng.below( people ) + 1 )) ;
+  state.SetItemsProcessed( state.iterations() ) ;
+} // :: link
+
+void find_relations( benchmark::State &state )
+{
+  uint32_t             people = (uint32_t)state.range( 0 ) ;
+  Population          &pop    = population( people ) ;
+  SplitMix             rng( 13 ) ;
+  SlotHitVec           hits ;
+  SlotScratch          scratch ;
+  std::vector<double>  ns ;
+  uint64_t             reached = 0 ;
+
+  for (auto _ : state)
+  {
+    Clock::time_point  t = Clock::now() ;
+    pop.mgr.find_relations( rng.below( people ) + 1, hits, scratch, depth ) ;
+    ns.push_back( (double)std::chrono::duration_cast<std::chrono::nanoseconds>( Clock::now() - t ).count() ) ;
+    reached += hits.size() ;
+  }
+  state.SetItemsProcessed( state.iterations() ) ;
+  state.counters["hits/query"] = (double)reached / (double)state.iterations() ;
+  report_latency( state, ns ) ;
+} // :: find_relations
+
+void find_path( benchmark::State &state )
+{
+  uint32_t             people = (uint32_t)state.range( 0 ) ;
+  Population          &pop    = population( people ) ;
+  SplitMix             rng( 17 ) ;
+  RelationPath         found ;
+  PathScratch          scratch ;
+  std::vector<double>  ns ;
+  uint64_t             related = 0 ;
+
+  for (auto _ : state)
+  {
+    Clock::time_point  t = Clock::now() ;
+    related += pop.mgr.find_path( rng.below( people ) + 1, rng.below( people ) + 1, found, scratch ) ;
+    ns.push_back( (double)std::chrono::duration_cast<std::chrono::nanoseconds>( Clock::now() - t ).count() ) ;
+  }
+  state.SetItemsProcessed( state.iterations() ) ;
+  state.counters["related"] = (double)related / (double)state.iterations() ;
+  report_latency( state, ns ) ;
+} // :: find_path
+
+// every female, by visiting each entity (scan_meta) ...
+void scan_meta( benchmark::State &state )
+{
+  uint32_t     people = (uint32_t)state.range( 0 ) ;
+  Population  &pop    = population( people ) ;
+  MetaTermVec  terms( 1, MetaTerm( MetaKey( "gender" ), "female" )) ;
+  IdVec        ids ;
+
+  for (auto _ : state)
+    pop.mgr.scan_meta( terms, ids ) ;
+  state.SetItemsProcessed( state.iterations() * people ) ;
+} // :: scan_meta
+
+// ... and by scanning the gender column
+void select_meta( benchmark::State &state )
+{
+  uint32_t     people = (uint32_t)state.range( 0 ) ;
+  Population  &pop    = population( people ) ;
+  MetaValue    female( "female" ) ;
+  Selection    sel ;
+
+  pop.mgr.columnar_meta( "gender" ) ;
+  for (auto _ : state)
+  {
+    pop.mgr.select_meta( MetaKey( "gender" ), female, sel ) ;
+    benchmark::DoNotOptimize( sel.words() ) ;
+  }
+  state.SetItemsProcessed( state.iterations() * people ) ;
+  state.counters["simd"] = simd_enabled() ? 1 : 0 ;
+} // :: select_meta
+
+//-----------------------------------------------------------------------------
+// option handling
+//
+
+// strips our own --name=value options out of argv
+bool option( const char *arg, const char *name, const char *&value )
+{
+  size_t  n = strlen( name ) ;
+  if (strncmp( arg, name, n ) != 0 || arg[n] != '=')
+    return false ;
+  value = arg + n + 1 ;
+  return true ;
+} // :: option
+
+std::vector<uint32_t> parse_options( int &argc, char **argv )
+{
+  std::vector<uint32_t>  sizes ;
+  int                    out = 1 ;
+  const char            *v ;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (option( argv[i], "--people", v ))
+    {
+      for (char *end; *v != '\0'; v = (*end == ',') ? end + 1 : end)
+      {
+        sizes.push_back( (uint32_t)strtoul( v, &end, 10 )) ;
+        if (end == v)
+          break ;
+      }
+    }
+    else if (option( argv[i], "--fanout", v ))
+      config.fan_out = atof( v ) ;
+    else if (option( argv[i], "--marriage", v ))
+      config.marriage_rate = atof( v ) ;
+    else if (option( argv[i], "--generations", v ))
+      config.generations = (uint32_t)strtoul( v, nullptr, 10 ) ;
+    else if (option( argv[i], "--depth", v ))
+      depth = (uint32_t)strtoul( v, nullptr, 10 ) ;
+    else if (option( argv[i], "--seed", v ))
+      config.seed = strtoull( v, nullptr, 10 ) ;
+    else
+      argv[out++] = argv[i] ;
+  }
+  argc = out ;
+  if (sizes.empty())
+    sizes = { 1000, 100000 } ;
+  return sizes ;
+} // :: parse_options
+
+}} ;
+
+//-----------------------------------------------------------------------------
+//
+//
+
+int main( int argc, char **argv )
+{
+  using namespace boost :: relations ;
+
+  std::vector<uint32_t>  sizes = parse_options( argc, argv ) ;
+
+  for (size_t i = 0; i < sizes.size(); i++)
+  {
+    benchmark::RegisterBenchmark( "ingest"        , ingest         )->Arg( sizes[i] )->Unit( benchmark::kMillisecond )->UseRealTime() ;
+    benchmark::RegisterBenchmark( "ingest_typed"  , ingest_typed   )->Arg( sizes[i] )->Unit( benchmark::kMillisecond )->UseRealTime() ;
+    benchmark::RegisterBenchmark( "ingest_logged" , ingest_logged  )->Arg( sizes[i] )->Unit( benchmark::kMillisecond )->UseRealTime() ;
+    benchmark::RegisterBenchmark( "replay"        , replay         )->Arg( sizes[i] )->Unit( benchmark::kMillisecond )->UseRealTime() ;
+    benchmark::RegisterBenchmark( "get"           , get            )->Arg( sizes[i] ) ;
+    benchmark::RegisterBenchmark( "link"          , link           )->Arg( sizes[i] ) ;
+    benchmark::RegisterBenchmark( "find_relations", find_relations )->Arg( sizes[i] )->Unit( benchmark::kMicrosecond ) ;
+    benchmark::RegisterBenchmark( "find_path"     , find_path      )->Arg( sizes[i] )->Unit( benchmark::kMicrosecond ) ;
+    benchmark::RegisterBenchmark( "scan_meta"     , scan_meta      )->Arg( sizes[i] )->Unit( benchmark::kMicrosecond ) ;
+    benchmark::RegisterBenchmark( "select_meta"   , select_meta    )->Arg( sizes[i] )->Unit( benchmark::kMicrosecond ) ;
+  }
+
+  benchmark::Initialize( &argc, argv ) ;
+  if (benchmark::ReportUnrecognizedArguments( argc, argv ))
+    return 1 ;
+  benchmark::RunSpecifiedBenchmarks() ;
+  benchmark::Shutdown() ;
+  return 0 ;
+} // :: main
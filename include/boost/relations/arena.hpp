@@ -0,0 +1,190 @@
+/*!
+  @file       arena.hpp
+  @brief      Memory resources, allocator adaptor and slab storage
+
+  @author     Robert McInnis
+  @date       september 21, 2016
+  @par        copyright (c) 2016 Solid ICE Technologies, Inc.  All rights reserved.
+
+  Distributed under the Boost Software License, Version 1.0. (See accompanying
+  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+*/
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace boost { namespace relations {
+
+// class:  MemoryResource
+// desc:   untyped allocation interface an EntityMgr draws its storage from
+//
+class MemoryResource
+{
+  public  :
+    virtual       ~MemoryResource() {}
+
+    virtual void  *allocate( size_t bytes, size_t align ) = 0 ;
+    virtual void   deallocate( void *p, size_t bytes, size_t align ) = 0 ;
+
+    static MemoryResource *heap() ;
+} ; // class MemoryResource
+
+// class:  HeapResource
+// desc:   plain operator new / delete
+//
+class HeapResource : public MemoryResource
+{
+  public  :
+    void          *allocate( size_t bytes, size_t ) { return ::operator new( bytes ) ; }
+    void           deallocate( void *p, size_t, size_t ) { ::operator delete( p ) ; }
+} ; // class HeapResource
+
+inline MemoryResource *MemoryResource::heap()
+{
+  static HeapResource  r ;
+  return &r ;
+} // MemoryResource :: heap
+
+// class:  ArenaResource
+// desc:   monotonic bump allocator.  deallocate is a no-op; everything is
+//         returned at once by release() or destruction.  suited to loads
+//         where nothing is freed until the whole population goes away
+//
+class ArenaResource : public MemoryResource
+{
+  private :
+    MemoryResource      *_upstream ;
+    size_t               _block_size ;
+    std::vector<char*>   _blocks ;
+    char                *_cur ;
+    char                *_end ;
+
+                   ArenaResource( const ArenaResource & ) ;
+    ArenaResource &operator= ( const ArenaResource & ) ;
+
+  public  :
+                   ArenaResource( size_t block_size_ = 1 << 20, MemoryResource *upstream_ = MemoryResource::heap() )
+                   : _upstream( upstream_ ), _block_size( block_size_ ), _cur( nullptr ), _end( nullptr ) {}
+                  ~ArenaResource() { release() ; }
+
+    void          *allocate( size_t bytes, size_t align )
+                   {
+                     uintptr_t  p = ((uintptr_t)_cur + (align - 1)) & ~(uintptr_t)(align - 1) ;
+                     if (_cur == nullptr || p + bytes > (uintptr_t)_end)
+                     {
+                       size_t  size = (bytes + align > _block_size) ? bytes + align : _block_size ;
+                       char   *b    = (char*)_upstream->allocate( size, alignof(std::max_align_t) ) ;
+                       _blocks.push_back( b ) ;
+                       _cur = b ;
+                       _end = b + size ;
+                       p    = ((uintptr_t)_cur + (align - 1)) & ~(uintptr_t)(align - 1) ;
+                     }
+                     _cur = (char*)(p + bytes) ;
+                     return (void*)p ;
+                   }
+    void           deallocate( void *, size_t, size_t ) {}
+
+    void           release()
+                   {
+                     for (size_t i = 0; i < _blocks.size(); i++)
+                       _upstream->deallocate( _blocks[i], 0, alignof(std::max_align_t) ) ;
+                     _blocks.clear() ;
+                     _cur = _end = nullptr ;
+                   }
+} ; // class ArenaResource
+
+// class:  ResourceAllocator
+// desc:   std allocator adaptor so standard containers can draw from a
+//         MemoryResource
+//
+template <typename T>
+class ResourceAllocator
+{
+  public  :
+    typedef T      value_type ;
+
+    MemoryResource *resource ;
+
+                   ResourceAllocator( MemoryResource *resource_ = MemoryResource::heap() ) : resource( resource_ ) {}
+    template <typename U>
+                   ResourceAllocator( const ResourceAllocator<U> &o ) : resource( o.resource ) {}
+
+    T             *allocate( size_t n ) { return (T*)resource->allocate( n * sizeof(T), alignof(T) ) ; }
+    void           deallocate( T *p, size_t n ) { resource->deallocate( p, n * sizeof(T), alignof(T) ) ; }
+
+    template <typename U>
+    bool           operator== ( const ResourceAllocator<U> &o ) const { return resource == o.resource ; }
+    template <typename U>
+    bool           operator!= ( const ResourceAllocator<U> &o ) const { return resource != o.resource ; }
+} ; // class ResourceAllocator
+
+// class:  Slab
+// desc:   chunked object storage.  objects never move once created, chunks
+//         are allocated 'chunk_size' objects at a time and everything is
+//         destroyed in one pass by clear()
+//
+template <typename T>
+class Slab
+{
+  private :
+    MemoryResource      *_resource ;
+    size_t               _chunk_size ;
+    std::vector<T*>      _chunks ;
+    size_t               _used ;      // objects used in the last chunk
+
+                   Slab( const Slab & ) ;
+    Slab          &operator= ( const Slab & ) ;
+
+  public  :
+                   Slab( MemoryResource *resource_ = MemoryResource::heap(), size_t chunk_size_ = 4096 )
+                   : _resource( resource_ ), _chunk_size( chunk_size_ ), _used( chunk_size_ ) {}
+                  ~Slab() { clear() ; }
+
+    template <typename... Args>
+    T             *create( Args&&... args )
+                   {
+                     if (_used == _chunk_size)
+                     {
+                       _chunks.push_back( (T*)_resource->allocate( _chunk_size * sizeof(T), alignof(T) )) ;
+                       _used = 0 ;
+                     }
+                     T  *p = new (_chunks.back() + _used) T( std::forward<Args>(args)... ) ;
+                     _used++ ;
+                     return p ;
+                   }
+
+    // destroy object 'i' and build a new one in its place
+    template <typename... Args>
+    T             *replace( size_t i, Args&&... args )
+                   {
+                     T  *p = at( i ) ;
+                     p->~T() ;
+                     return new (p) T( std::forward<Args>(args)... ) ;
+                   }
+
+    size_t         size() const { return _chunks.empty() ? 0 : (_chunks.size() - 1) * _chunk_size + _used ; }
+    T             *at( size_t i ) const { return _chunks[i / _chunk_size] + (i % _chunk_size) ; }
+    size_t         capacity() const { return _chunks.size() * _chunk_size ; }
+
+    void           clear()
+                   {
+                     for (size_t c = 0; c < _chunks.size(); c++)
+                     {
+                       size_t  n = (c + 1 == _chunks.size()) ? _used : _chunk_size ;
+                       for (size_t i = 0; i < n; i++)
+                         _chunks[c][i].~T() ;
+                       _resource->deallocate( _chunks[c], _chunk_size * sizeof(T), alignof(T) ) ;
+                     }
+                     _chunks.clear() ;
+                     _used = _chunk_size ;
+                   }
+} ; // class Slab
+
+}} ; // namespace
+
+#endif
@@ -0,0 +1,638 @@
+/*!
+  @file       change_log.hpp
+  @brief      Append-only binary log of EntityMgr edits, with group commit and replay
+
+  @author     Robert McInnis
+  @date       september 21, 2016
+  @par        copyright (c) 2016 Solid ICE Technologies, Inc.  All rights reserved.
+
+  Distributed under the Boost Software License, Version 1.0. (See accompanying
+  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+  file layout, every integer little-endian:
+
+    header   magic "BRELLOG\0", u32 version, u32 byte-order mark, u64 base
+    batch    u32 payload bytes, u32 checksum of the payload, payload
+    ...
+
+  a payload is a run of records, each a u8 op followed by u32 fields:
+
+    relation / key / value   log id, name length, name chars
+    create                   entity
+    link / unlink            from, relation, to
+    meta                     entity, key, value
+    erase                    entity, scan_all
+    clear
+
+  relations, keys and values are written as the ids of the writing process;
+  a naming record precedes the first use of each id in the file and replay
+  interns the names again, so a log does not depend on interning order.
+  records are effects, reciprocal links included, so replay needs no rules.
+  'base' names the snapshot the log applies to (see journal.hpp).  a crash
+  can leave a torn last batch: replay stops at the first batch that is
+  short, fails its checksum or holds a malformed record, applying none of
+  it, and open() cuts the file back to it
+*/
+#ifndef CHANGE_LOG_HPP
+#define CHANGE_LOG_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/relations/entity.hpp>
+#include <boost/relations/mapped_file.hpp>
+#include <boost/relations/stats.hpp>
+#include <boost/relations/symbol.hpp>
+
+namespace boost { namespace relations {
+
+// struct: LogInfo
+// desc:   what a scan or replay of a change log found
+//
+struct LogInfo
+{
+  uint64_t         base ;
+  uint64_t         bytes ;     // file size up to the end of the last whole batch
+  uint64_t         batches ;
+  uint64_t         records ;
+  bool             torn ;      // something followed the last whole batch
+
+                   LogInfo() : base( 0 ), bytes( 0 ), batches( 0 ), records( 0 ), torn( false ) {}
+} ; // struct LogInfo
+
+// class:  ChangeLog
+// desc:   writer side of the log.  records go to an in-memory batch under a
+//         mutex; commit() makes everything appended so far durable.  commits
+//         from several threads are grouped: one thread writes and syncs the
+//         batch while the others wait for it, and appends carry on into the
+//         next batch meanwhile.  a batch that reaches 'group_bytes' is
+//         written out early, unsynced, by the next spill().  record calls
+//         never do I/O or wait: Entity and EntityMgr make them under their
+//         own locks, and spill once those are released
+//
+class ChangeLog
+{
+  public  :
+    static const uint32_t version             = 1 ;
+    static const uint32_t header_bytes        = 24 ;
+    static const uint32_t batch_header_bytes  = 8 ;
+    static const size_t   default_group_bytes = 1 << 20 ;
+
+    enum Op
+    {
+      op_relation = 1, op_key, op_value,
+      op_create, op_link, op_unlink, op_meta, op_erase, op_clear
+    } ;
+
+    // checksum of a batch payload: FNV-1a taken a word at a time, folded
+    // to 32 bits
+    static uint32_t checksum( const uint8_t *p, size_t n )
+                   {
+                     uint64_t  h = 14695981039346656037ull ^ n ;
+                     uint64_t  w ;
+                     size_t    i = 0 ;
+                     for (; i + 8 <= n; i += 8)
+                     {
+                       memcpy( &w, p + i, 8 ) ;
+                       h = (h ^ w) * 1099511628211ull ;
+                     }
+                     for (; i < n; i++)
+                       h = (h ^ p[i]) * 1099511628211ull ;
+                     return (uint32_t)(h ^ (h >> 32)) ;
+                   }
+
+  private :
+    FILE                    *_file ;
+    size_t                   _group_bytes ;
+    bool                     _sync ;
+    bool                     _ok ;
+    uint64_t                 _base ;
+    std::mutex               _lock ;
+    std::condition_variable  _idle ;
+    bool                     _flushing ;
+    std::atomic<bool>        _full ;       // _pending reached _group_bytes
+    std::vector<uint8_t>     _pending ;
+    std::vector<uint8_t>     _batch ;      // the batch being written
+    uint64_t                 _appended ;   // record bytes appended
+    uint64_t                 _written ;    // ... handed to the file
+    uint64_t                 _synced ;     // ... known to be on disk
+    uint64_t                 _size ;       // file bytes written
+    uint64_t                 _records ;
+    std::vector<bool>        _named[3] ;   // ids named in this file; relation, key, value
+
+                   ChangeLog( const ChangeLog & ) ;
+    ChangeLog     &operator= ( const ChangeLog & ) ;
+
+    static const char *magic() { return "BRELLOG\0" ; }
+
+    static void    put32( uint8_t *p, uint32_t v )
+                   {
+                     p[0] = (uint8_t)v ;
+                     p[1] = (uint8_t)(v >> 8) ;
+                     p[2] = (uint8_t)(v >> 16) ;
+                     p[3] = (uint8_t)(v >> 24) ;
+                   }
+    static uint32_t get32( const uint8_t *p )
+                   {
+                     return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24) ;
+                   }
+
+    void           put8( uint8_t v ) { _pending.push_back( v ) ; }
+    void           put32( uint32_t v )
+                   {
+                     uint8_t  b[4] ;
+                     put32( b, v ) ;
+                     _pending.insert( _pending.end(), b, b + 4 ) ;
+                   }
+    // one record of 'op' and up to three fields, in a single insert
+    void           put( Op op, uint32_t fields, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0 )
+                   {
+                     uint8_t  r[13] ;
+                     r[0] = (uint8_t)op ;
+                     put32( r + 1, a ) ;
+                     put32( r + 5, b ) ;
+                     put32( r + 9, c ) ;
+                     _pending.insert( _pending.end(), r, r + 1 + fields * 4 ) ;
+                   }
+    // the naming record for 's', the first time this file sees it
+    template <typename Tag>
+    void           name( Op op, Symbol<Tag> s )
+                   {
+                     std::vector<bool>  &named = _named[op - op_relation] ;
+                     uint32_t            id    = s.id() ;
+                     if (id < named.size() && named[id])
+                       return ;
+                     if (named.size() <= id)
+                       named.resize( id + 1, false ) ;
+                     named[id] = true ;
+
+                     const std::string  &str = s.str() ;
+                     put8( (uint8_t)op ) ;
+                     put32( id ) ;
+                     put32( (uint32_t)str.size() ) ;
+                     _pending.insert( _pending.end(), str.begin(), str.end() ) ;
+                   }
+    void           appended( size_t before )
+                   {
+                     _appended += _pending.size() - before ;
+                     _records++ ;
+                     BOOST_RELATIONS_COUNT( log_records, 1 ) ;
+                     if (_pending.size() >= _group_bytes)
+                       _full.store( true, std::memory_order_relaxed ) ;
+                   }
+
+    bool           write_batch( const std::vector<uint8_t> &batch )
+                   {
+                     if (batch.empty())
+                       return true ;
+                     uint8_t  head[batch_header_bytes] ;
+                     put32( head, (uint32_t)batch.size() ) ;
+                     put32( head + 4, checksum( batch.data(), batch.size() )) ;
+                     bool  ok = fwrite( head, 1, sizeof(head), _file ) == sizeof(head) &&
+                                fwrite( batch.data(), 1, batch.size(), _file ) == batch.size() &&
+                                fflush( _file ) == 0 ;
+                     BOOST_RELATIONS_COUNT( log_batches, 1 ) ;
+                     return ok ;
+                   }
+    bool           sync_file()
+                   {
+                     BOOST_RELATIONS_TIME( log_sync_ns ) ;
+                     BOOST_RELATIONS_COUNT( log_syncs, 1 ) ;
+#ifdef BOOST_RELATIONS_HAS_MMAP
+                     return fsync( fileno( _file )) == 0 ;
+#else
+                     return true ;
+#endif
+                   }
+
+    // write out (and with 'sync_', sync) everything appended before the
+    // call.  one thread at a time does the I/O, without holding _lock, and
+    // takes whatever has accumulated by then; the others wait for it
+    void           flush( std::unique_lock<std::mutex> &guard, bool sync_ )
+                   {
+                     uint64_t  target = _appended ;
+                     while (_ok && (sync_ ? _synced : _written) < target)
+                     {
+                       if (_flushing)
+                       {
+                         _idle.wait( guard ) ;
+                         continue ;
+                       }
+                       _flushing = true ;
+                       _batch.swap( _pending ) ;
+                       _full.store( false, std::memory_order_relaxed ) ;
+                       uint64_t  upto = _appended ;
+                       guard.unlock() ;
+
+                       bool  ok = write_batch( _batch ) && (!sync_ || sync_file()) ;
+
+                       guard.lock() ;
+                       if (!_batch.empty())
+                         _size += batch_header_bytes + _batch.size() ;
+                       _batch.clear() ;
+                       _written = upto ;
+                       if (sync_)
+                         _synced = upto ;
+                       _ok       = _ok && ok ;
+                       _flushing = false ;
+                       _idle.notify_all() ;
+                     }
+                   }
+
+    void           start( FILE *f, uint64_t base, uint64_t size )
+                   {
+                     _file     = f ;
+                     _ok       = true ;
+                     _base     = base ;
+                     _size     = size ;
+                     _appended = _written = _synced = 0 ;
+                     _records  = 0 ;
+                     for (int k = 0; k < 3; k++)
+                       _named[k].clear() ;
+                   }
+
+    // one decoded record; b and c hold this process's symbol ids
+    struct Record
+    {
+      uint8_t      op ;
+      uint32_t     a ;
+      uint32_t     b ;
+      uint32_t     c ;
+    } ;
+    typedef std::vector<Record>    RecordVec ;
+    typedef std::vector<uint32_t>  SymbolIds ;
+
+    static bool    decode( const uint8_t *r, const uint8_t *last, SymbolIds ids[3], RecordVec &out ) ;
+    static void    apply( const RecordVec &records, EntityMgr &mgr ) ;
+    // reads the log at 'path', applying it to 'mgr' unless that is nullptr
+    static bool    scan( const std::string &path, EntityMgr *mgr, LogInfo &info ) ;
+
+  public  :
+    explicit       ChangeLog( size_t group_bytes = default_group_bytes, bool sync = true )
+                   : _file( nullptr ), _group_bytes( group_bytes ), _sync( sync ), _ok( false ), _base( 0 ),
+                     _flushing( false ), _full( false ), _appended( 0 ), _written( 0 ), _synced( 0 ), _size( 0 ), _records( 0 ) {}
+                  ~ChangeLog() { close() ; }
+
+    // starts an empty log at 'path', replacing any file there
+    bool           create( const std::string &path, uint64_t base )
+                   {
+                     close() ;
+                     FILE  *f = fopen( path.c_str(), "wb" ) ;
+                     if (f == nullptr)
+                       return false ;
+
+                     uint8_t  head[header_bytes] ;
+                     memcpy( head, magic(), 8 ) ;
+                     put32( head + 8, version ) ;
+                     put32( head + 12, 0x01020304 ) ;
+                     put32( head + 16, (uint32_t)base ) ;
+                     put32( head + 20, (uint32_t)(base >> 32) ) ;
+                     start( f, base, header_bytes ) ;
+                     _ok = fwrite( head, 1, sizeof(head), f ) == sizeof(head) && fflush( f ) == 0 && (!_sync || sync_file()) ;
+                     if (!_ok)
+                       close() ;
+                     return _file != nullptr ;
+                   }
+
+    // appends to the log at 'path', which must follow 'base'; a missing or
+    // empty file is created.  a torn tail is cut off first
+    bool           open( const std::string &path, uint64_t base )
+                   {
+                     LogInfo  info ;
+                     if (!scan( path, nullptr, info ))
+                     {
+                       FILE  *f = fopen( path.c_str(), "rb" ) ;
+                       bool   blank = (f == nullptr) || (fgetc( f ) == EOF) ;
+                       if (f != nullptr)
+                         fclose( f ) ;
+                       return blank && create( path, base ) ;
+                     }
+                     return info.base == base && open( path, info ) ;
+                   }
+    // as above, trusting 'info' from a replay of the same file
+    bool           open( const std::string &path, const LogInfo &info )
+                   {
+                     close() ;
+#ifdef BOOST_RELATIONS_HAS_MMAP
+                     if (info.torn && truncate( path.c_str(), (off_t)info.bytes ) != 0)
+                       return false ;
+#else
+                     if (info.torn)
+                       return false ;
+#endif
+                     FILE  *f = fopen( path.c_str(), "ab" ) ;
+                     if (f == nullptr)
+                       return false ;
+                     start( f, info.base, info.bytes ) ;
+                     return true ;
+                   }
+
+    // commits what is pending, then closes the file
+    void           close()
+                   {
+                     if (_file == nullptr)
+                       return ;
+                     commit() ;
+                     fclose( _file ) ;
+                     _file = nullptr ;
+                     _ok   = false ;
+                   }
+
+    // durable once this returns: written, and synced unless the log was
+    // made with sync == false.  false if any write failed
+    bool           commit()
+                   {
+                     std::unique_lock<std::mutex>  guard( _lock ) ;
+                     if (_file != nullptr)
+                       flush( guard, _sync ) ;
+                     return _ok ;
+                   }
+
+    // writes out a batch that has reached 'group_bytes', unless another
+    // thread is already writing; cheap when there is none.  call it with
+    // no locks held
+    void           spill()
+                   {
+                     if (!_full.load( std::memory_order_relaxed ))
+                       return ;
+                     std::unique_lock<std::mutex>  guard( _lock ) ;
+                     if (_file != nullptr && !_flushing && _pending.size() >= _group_bytes)
+                       flush( guard, false ) ;
+                   }
+
+    bool           is_open() const { return _file != nullptr ; }
+    bool           ok() const { return _ok ; }
+    uint64_t       base() const { return _base ; }
+    uint64_t       size() const { return _size ; }         // bytes written to the file
+    uint64_t       records() const { return _records ; }   // appended since open()
+
+    //-------------------------------------------------------------------------
+    // records; called by Entity and EntityMgr once attached with
+    // EntityMgr::change_log()
+    //
+    void           created( uint32_t id )
+                   {
+                     std::lock_guard<std::mutex>   guard( _lock ) ;
+                     if (!_ok)
+                       return ;
+                     size_t  before = _pending.size() ;
+                     put( op_create, 1, id ) ;
+                     appended( before ) ;
+                   }
+    void           linked( bool added, uint32_t from, RelationType type_, uint32_t to )
+                   {
+                     std::lock_guard<std::mutex>   guard( _lock ) ;
+                     if (!_ok)
+                       return ;
+                     size_t  before = _pending.size() ;
+                     name( op_relation, type_ ) ;
+                     put( added ? op_link : op_unlink, 3, from, type_.id(), to ) ;
+                     appended( before ) ;
+                   }
+    void           meta_added( uint32_t id, MetaKey key, MetaValue value )
+                   {
+                     std::lock_guard<std::mutex>   guard( _lock ) ;
+                     if (!_ok)
+                       return ;
+                     size_t  before = _pending.size() ;
+                     name( op_key, key ) ;
+                     name( op_value, value ) ;
+                     put( op_meta, 3, id, key.id(), value.id() ) ;
+                     appended( before ) ;
+                   }
+    void           erased( uint32_t id, bool scan_all )
+                   {
+                     std::lock_guard<std::mutex>   guard( _lock ) ;
+                     if (!_ok)
+                       return ;
+                     size_t  before = _pending.size() ;
+                     put( op_erase, 2, id, scan_all ? 1 : 0 ) ;
+                     appended( before ) ;
+                   }
+    void           cleared()
+                   {
+                     std::lock_guard<std::mutex>   guard( _lock ) ;
+                     if (!_ok)
+                       return ;
+                     size_t  before = _pending.size() ;
+                     put( op_clear, 0 ) ;
+                     appended( before ) ;
+                   }
+
+    //-------------------------------------------------------------------------
+    // reading
+    //
+
+    // the edits in 'path' applied to 'mgr', which should have no change log
+    // attached.  stops at a torn tail; false if the file is missing or not
+    // a change log
+    static bool    replay( const std::string &path, EntityMgr &mgr, LogInfo &info ) { return scan( path, &mgr, info ) ; }
+    // checks every batch without applying anything
+    static bool    inspect( const std::string &path, LogInfo &info ) { return scan( path, nullptr, info ) ; }
+    // just the header
+    static bool    read_base( const std::string &path, uint64_t &base )
+                   {
+                     FILE  *f = fopen( path.c_str(), "rb" ) ;
+                     if (f == nullptr)
+                       return false ;
+                     uint8_t  head[header_bytes] ;
+                     bool     ok = fread( head, 1, sizeof(head), f ) == sizeof(head) && memcmp( head, magic(), 8 ) == 0 &&
+                                   get32( head + 8 ) == version && get32( head + 12 ) == 0x01020304 ;
+                     fclose( f ) ;
+                     if (ok)
+                       base = (uint64_t)get32( head + 16 ) | ((uint64_t)get32( head + 20 ) << 32) ;
+                     return ok ;
+                   }
+} ; // class ChangeLog
+
+//-----------------------------------------------------------------------------
+// replay
+//
+
+// func:   decode
+// desc:   the records of one batch, symbols mapped to this process's ids
+//         through 'ids'; false at the first record that is malformed or
+//         uses an unnamed id
+//
+inline bool ChangeLog::decode( const uint8_t *r, const uint8_t *last, SymbolIds ids[3], RecordVec &out )
+{
+  static const uint32_t  fields[] = { 0, 2, 2, 2, 1, 3, 3, 3, 2, 0 } ;
+
+  out.clear() ;
+  while (r != last)
+  {
+    uint8_t  op = *r++ ;
+    if (op < op_relation || op > op_clear || (size_t)(last - r) < fields[op] * 4)
+      return false ;
+
+    Record  rec ;
+    rec.op = op ;
+    rec.a  = (fields[op] > 0) ? get32( r ) : 0 ;
+    rec.b  = (fields[op] > 1) ? get32( r + 4 ) : 0 ;
+    rec.c  = (fields[op] > 2) ? get32( r + 8 ) : 0 ;
+    r += fields[op] * 4 ;
+
+    switch (op)
+    {
+      case op_relation :
+      case op_key :
+      case op_value :
+      {
+        if ((size_t)(last - r) < rec.b)
+          return false ;
+        std::string  s( (const char*)r, rec.b ) ;
+        SymbolIds   &map = ids[op - op_relation] ;
+        r += rec.b ;
+        if (map.size() <= rec.a)
+          map.resize( (size_t)rec.a + 1, (uint32_t)SymbolTable::npos ) ;
+        map[rec.a] = (op == op_relation) ? RelationType( s ).id() : (op == op_key) ? MetaKey( s ).id() : MetaValue( s ).id() ;
+        continue ;
+      }
+      case op_link :
+      case op_unlink :
+        if (rec.b >= ids[0].size() || ids[0][rec.b] == SymbolTable::npos)
+          return false ;
+        rec.b = ids[0][rec.b] ;
+        break ;
+      case op_meta :
+        if (rec.b >= ids[1].size() || ids[1][rec.b] == SymbolTable::npos ||
+            rec.c >= ids[2].size() || ids[2][rec.c] == SymbolTable::npos)
+          return false ;
+        rec.b = ids[1][rec.b] ;
+        rec.c = ids[2][rec.c] ;
+        break ;
+    }
+    out.push_back( rec ) ;
+  }
+  return true ;
+} // ChangeLog :: decode
+
+// func:   apply
+//
+inline void ChangeLog::apply( const RecordVec &records, EntityMgr &mgr )
+{
+  for (RecordVec::const_iterator it = records.begin(); it != records.end(); it++)
+  {
+    const Record  &rec = (*it) ;
+    switch (rec.op)
+    {
+      case op_create :
+        mgr.get( rec.a ) ;
+        break ;
+      case op_link :
+        mgr.get( rec.a ).link( RelationType( rec.b ), mgr.get( rec.c )) ;
+        break ;
+      case op_unlink :
+      {
+        Entity  *from = mgr.find( rec.a ) ;
+        Entity  *to   = mgr.find( rec.c ) ;
+        if (from != nullptr && to != nullptr)
+          (*from).unlink( RelationType( rec.b ), *to ) ;
+        break ;
+      }
+      case op_meta :
+        mgr.get( rec.a ).meta( MetaKey( rec.b ), MetaValue( rec.c )) ;
+        break ;
+      case op_erase :
+        mgr.erase( rec.a, rec.b != 0 ) ;
+        break ;
+      case op_clear :
+        mgr.clear() ;
+        break ;
+    }
+  }
+} // ChangeLog :: apply
+
+// func:   scan
+// desc:   batch by batch: length and checksum, then every record decoded
+//         and checked, and only then applied, so a batch is taken whole or
+//         not at all.  log ids map to this process's symbols through the
+//         naming records
+//
+inline bool ChangeLog::scan( const std::string &path, EntityMgr *mgr, LogInfo &info )
+{
+  MappedFile  file ;
+  uint64_t    base ;
+
+  info = LogInfo() ;
+  if (!read_base( path, base ) || !file.open( path ))
+    return false ;
+
+  const uint8_t  *p   = file.data() + header_bytes ;
+  const uint8_t  *end = file.data() + file.size() ;
+  SymbolIds       ids[3] ;     // log id -> symbol id; relation, key, value
+  RecordVec       records ;
+
+  info.base  = base ;
+  info.bytes = header_bytes ;
+  while (p != end)
+  {
+    if ((size_t)(end - p) < batch_header_bytes)
+      break ;
+    uint32_t        n     = get32( p ) ;
+    const uint8_t  *batch = p + batch_header_bytes ;
+    if ((size_t)(end - batch) < n || checksum( batch, n ) != get32( p + 4 ) ||
+        !decode( batch, batch + n, ids, records ))
+      break ;
+
+    if (mgr != nullptr)
+      apply( records, *mgr ) ;
+    p             = batch + n ;
+    info.bytes   += batch_header_bytes + n ;
+    info.batches++ ;
+    info.records += records.size() ;
+  }
+  info.torn = (p != end) ;
+  return true ;
+} // ChangeLog :: scan
+
+//-----------------------------------------------------------------------------
+// Entity and EntityMgr hooks, declared in entity.hpp
+//
+
+inline void Entity::logged( bool added, RelationType type_, const Entity &other )
+{
+  _log->linked( added, _id, type_, other._id ) ;
+} // Entity :: logged
+
+inline void Entity::logged( MetaKey name, MetaValue value )
+{
+  _log->meta_added( _id, name, value ) ;
+} // Entity :: logged
+
+inline void EntityMgr::logged_create( uint32_t id )
+{
+  _log->created( id ) ;
+} // EntityMgr :: logged_create
+
+inline void EntityMgr::logged_erase( uint32_t id, bool scan_all )
+{
+  _log->erased( id, scan_all ) ;
+} // EntityMgr :: logged_erase
+
+inline void EntityMgr::logged_clear()
+{
+  _log->cleared() ;
+} // EntityMgr :: logged_clear
+
+inline void Entity::spill_log()
+{
+  if (_log != nullptr)
+    _log->spill() ;
+} // Entity :: spill_log
+
+inline void EntityMgr::spill_log()
+{
+  if (_log != nullptr)
+    _log->spill() ;
+} // EntityMgr :: spill_log
+
+}} ; // namespace
+
+#endif
@@ -0,0 +1,255 @@
+/*!
+  @file       closure_cache.hpp
+  @brief      Relation closures cached per root, invalidated by dependency
+
+  @author     Robert McInnis
+  @date       september 21, 2016
+  @par        copyright (c) 2016 Solid ICE Technologies, Inc.  All rights reserved.
+
+  Distributed under the Boost Software License, Version 1.0. (See accompanying
+  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+*/
+#ifndef CLOSURE_CACHE_HPP
+#define CLOSURE_CACHE_HPP
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/relations/entity.hpp>
+#include <boost/relations/traversal.hpp>
+
+namespace boost { namespace relations {
+
+// class:  ClosureCache
+// desc:   find_relations results for one TraversalSpec, kept per root slot.
+//         an entry depends on the entities whose links its traversal read:
+//         the root and every hit it walked through.  a reverse index
+//         (slot -> entries) lets a link change on one entity drop exactly
+//         the closures that read it; links of relations the spec doesn't
+//         follow never invalidate anything.  an entry and the index point
+//         at each other's positions, so dropping or replacing an entry
+//         takes it out of every slot it read in O(its reads), and the index
+//         holds live entries only.  a new link can shorten many paths at
+//         once, so affected entries are recomputed on their next lookup
+//         rather than patched.  all members lock
+//
+class ClosureCache
+{
+  private :
+    struct Read
+    {
+      uint32_t     slot ;
+      uint32_t     pos ;         // in _readers[slot]
+    } ;
+    struct Reader
+    {
+      uint32_t     root ;
+      uint32_t     read ;        // in the root entry's reads
+    } ;
+
+    typedef std::vector<Read>    ReadVec ;
+    typedef std::vector<Reader>  ReaderVec ;
+
+    struct Entry
+    {
+      SlotHitVec   hits ;
+      ReadVec      reads ;
+    } ;
+
+    typedef std::unordered_map<uint32_t, Entry>            EntryMap ;
+    typedef std::unordered_map<uint32_t, Entry>::iterator  EntryMap_iter ;
+
+    TraversalSpec            _spec ;
+    uint32_t                 _max_depth ;
+    EntryMap                 _entries ;    // root slot ->
+    std::vector<ReaderVec>   _readers ;    // slot -> entries that read its links
+    uint64_t                 _indexed ;    // roots held in _readers
+    uint64_t                 _edits ;      // invalidating changes so far
+    std::mutex               _lock ;
+
+                   ClosureCache( const ClosureCache & ) ;
+    ClosureCache  &operator= ( const ClosureCache & ) ;
+
+  public  :
+                   ClosureCache( const TraversalSpec &spec_, uint32_t max_depth_ )
+                   : _spec( spec_ ), _max_depth( max_depth_ ), _indexed( 0 ), _edits( 0 ) {}
+
+    const TraversalSpec &spec() const { return _spec ; }
+    uint32_t       max_depth() const { return _max_depth ; }
+
+    // copy the cached closure of 'root' into 'out'; false on a miss.
+    // 'edits' receives the change count to hand back to store()
+    bool           find( uint32_t root, SlotHitVec &out, uint64_t &edits )
+                   {
+                     std::lock_guard<std::mutex>  guard( _lock ) ;
+                     EntryMap_iter  it = _entries.find( root ) ;
+                     edits = _edits ;
+                     if (it == _entries.end())
+                       return false ;
+                     out = (*it).second.hits ;
+                     return true ;
+                   }
+
+    // keep 'hits' for 'root', unless links it may have read changed after
+    // the find() that returned 'edits'
+    void           store( uint32_t root, const SlotHitVec &hits, uint64_t edits )
+                   {
+                     std::lock_guard<std::mutex>  guard( _lock ) ;
+                     if (edits != _edits)
+                       return ;
+
+                     Entry  &e = _entries[root] ;
+                     unread( e ) ;
+                     e.hits = hits ;
+
+                     read( root, root, e ) ;
+                     for (SlotHitVec::const_iterator it = hits.begin(); it != hits.end(); it++)
+                     {
+                       // only hits the walk went through: not depth-capped, not reached by a stop rule
+                       PackedPath  p = (*it).path ;
+                       if (p.size() < _max_depth && !_spec.stops( p.back() ))
+                         read( (*it).node, root, e ) ;
+                     }
+                   }
+
+    // the links of 'slot' under 'type_' changed
+    void           changed( uint32_t slot, RelationType type_ )
+                   {
+                     if (_spec.code_of( type_ ) == TraversalSpec::none)
+                       return ;
+
+                     std::lock_guard<std::mutex>  guard( _lock ) ;
+                     _edits++ ;
+                     while (slot < _readers.size() && !_readers[slot].empty())
+                     {
+                       EntryMap_iter  e = _entries.find( _readers[slot].back().root ) ;
+                       unread( (*e).second ) ;
+                       _entries.erase( e ) ;
+                     }
+                   }
+
+    uint32_t       size()
+                   {
+                     std::lock_guard<std::mutex>  guard( _lock ) ;
+                     return (uint32_t)_entries.size() ;
+                   }
+    // reverse index entries; bounded by the cached closures' reads
+    uint64_t       indexed()
+                   {
+                     std::lock_guard<std::mutex>  guard( _lock ) ;
+                     return _indexed ;
+                   }
+    void           clear()
+                   {
+                     std::lock_guard<std::mutex>  guard( _lock ) ;
+                     _entries.clear() ;
+                     _readers.clear() ;
+                     _indexed = 0 ;
+                     _edits++ ;
+                   }
+
+  private :
+    void           read( uint32_t slot, uint32_t root, Entry &e )
+                   {
+                     if (slot >= _readers.size())
+                       _readers.resize( slot + 1 ) ;
+                     Read    r = { slot, (uint32_t)_readers[slot].size() } ;
+                     Reader  b = { root, (uint32_t)e.reads.size() } ;
+                     _readers[slot].push_back( b ) ;
+                     e.reads.push_back( r ) ;
+                     _indexed++ ;
+                   }
+    // takes 'e' out of every slot it read: each a swap with the slot's last
+    // reader, whose entry then learns its new position
+    void           unread( Entry &e )
+                   {
+                     for (ReadVec::const_iterator it = e.reads.begin(); it != e.reads.end(); it++)
+                     {
+                       ReaderVec  &readers = _readers[(*it).slot] ;
+                       Reader      last    = readers.back() ;
+                       readers.pop_back() ;
+                       _indexed-- ;
+                       if ((*it).pos == readers.size())
+                         continue ;
+                       readers[(*it).pos] = last ;
+                       _entries[last.root].reads[last.read].pos = (*it).pos ;
+                     }
+                     e.reads.clear() ;
+                   }
+} ; // class ClosureCache
+
+//-----------------------------------------------------------------------------
+// Entity / EntityMgr hooks
+//
+
+inline void Entity::changed( RelationType type_ )
+{
+  _closures->changed( _slot, type_ ) ;
+} // Entity :: changed
+
+inline EntityMgr::~EntityMgr()
+{
+  _log = nullptr ;
+  teardown() ;
+} // EntityMgr :: ~EntityMgr
+
+inline void EntityMgr::clear_closures()
+{
+  _closures->clear() ;
+} // EntityMgr :: clear_closures
+
+inline void EntityMgr::cache_relations( const TraversalSpec &spec, uint32_t max_depth )
+{
+  if (max_depth > PackedPath::max_steps)
+    max_depth = PackedPath::max_steps ;
+  _closures.reset( new ClosureCache( spec, max_depth )) ;
+  for (iterator it = begin(); it != end(); it++)
+    (*it).closure_cache( _closures.get() ) ;
+} // EntityMgr :: cache_relations
+
+inline void EntityMgr::cache_relations()
+{
+  cache_relations( TraversalSpec::family(), PackedPath::max_steps ) ;
+} // EntityMgr :: cache_relations
+
+inline void EntityMgr::uncache_relations()
+{
+  for (iterator it = begin(); it != end(); it++)
+    (*it).closure_cache( nullptr ) ;
+  _closures.reset() ;
+} // EntityMgr :: uncache_relations
+
+inline uint32_t EntityMgr::closures_cached() const
+{
+  return _closures ? _closures->size() : 0 ;
+} // EntityMgr :: closures_cached
+
+inline uint64_t EntityMgr::closure_readers() const
+{
+  return _closures ? _closures->indexed() : 0 ;
+} // EntityMgr :: closure_readers
+
+inline void EntityMgr::cached_relations( uint32_t id, SlotHitVec &out, SlotScratch &scratch ) const
+{
+  Entity    *root = find( id ) ;
+  uint64_t   edits ;
+
+  out.clear() ;
+  if (root == nullptr)
+    return ;
+  if (!_closures)
+  {
+    find_relations( id, out, scratch ) ;
+    return ;
+  }
+  if (_closures->find( root->slot(), out, edits ))
+    return ;
+  find_relations( id, _closures->spec(), out, scratch, _closures->max_depth() ) ;
+  _closures->store( root->slot(), out, edits ) ;
+} // EntityMgr :: cached_relations
+
+}} ; // namespace
+
+#endif
@@ -12,20 +12,47 @@
 #ifndef ENTITY_HPP
 #define ENTITY_HPP
 
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#include <boost/relations/arena.hpp>
+#include <boost/relations/entity_index.hpp>
+#include <boost/relations/flat_map.hpp>
+#include <boost/relations/meta_index.hpp>
+#include <boost/relations/meta_set.hpp>
+#include <boost/relations/packed_path.hpp>
+#include <boost/relations/spin_lock.hpp>
+#include <boost/relations/stats.hpp>
+#include <boost/relations/symbol.hpp>
+
 namespace boost { namespace relations {
 
 class Entity ;
+class TraversalSpec ;
+class ThreadPool ;
+class ClosureCache ;
+class ChangeLog ;
+struct EntityGraph ;
+struct RelationPath ;
+class  PathScratch ;
+
+template <typename Node>  struct TraversalHit ;
+template <typename Graph> class  TraversalScratch ;
 
-typedef std::vector<std::string>                           MetaVec ;
-typedef std::vector<std::string>::iterator                 MetaVec_iter ;
+struct SlotGraph ;
 
-typedef std::map< std::string, MetaVec >                   MetaMap ;
-typedef std::map< std::string, MetaVec >::iterator         MetaMap_iter ;
-typedef std::map< std::string, MetaVec >::value_type       MetaMap_pair ;
+typedef TraversalScratch<EntityGraph>                      EntityScratch ;
+typedef TraversalScratch<SlotGraph>                        SlotScratch ;
+typedef std::vector< TraversalHit<Entity*> >               EntityHitVec ;
+typedef std::vector< TraversalHit<uint32_t> >              SlotHitVec ;
 
 typedef std::map<Entity*, std::string>                     EntityRelationMap ;
 typedef std::map<Entity*, std::string>::iterator           EntityRelationMap_iter ;
@@ -34,9 +61,21 @@ typedef std::map<Entity*, std::string>::value_type         EntityRelationMap_pai
 typedef std::vector<Entity*>                               EntityVec ;
 typedef std::vector<Entity*>::iterator                     EntityVec_iter ;
 
-typedef std::map< std::string, EntityVec >                 RelationMap ;
-typedef std::map< std::string, EntityVec >::iterator       RelationMap_iter ;
-typedef std::map< std::string, EntityVec >::value_type     RelationMap_pair ;
+typedef FlatMap< RelationType, EntityVec >                 RelationMap ;
+typedef FlatMap< RelationType, EntityVec >::iterator       RelationMap_iter ;
+typedef FlatMap< RelationType, EntityVec >::value_type     RelationMap_pair ;
+
+typedef std::unordered_set<Entity*>                                          EntitySet ;
+typedef std::unordered_map< RelationType, EntitySet, SymbolHash<RelationTag> > HubIndex ;
+typedef std::unordered_map< RelationType, EntitySet, SymbolHash<RelationTag> >::iterator HubIndex_iter ;
+
+// enum:   Adjacency
+// desc:   per-EntityMgr choice of link membership checking.  'compact' keeps
+//         only the flat target vectors (linear scan, least memory); 'indexed'
+//         adds a hash set to any relation whose degree reaches the hub
+//         threshold so link/is_linked stay O(1) on high-degree entities
+//
+enum class Adjacency { compact, indexed } ;
 
 // class:  Entity
 // desc:   root relatable construct 
@@ -44,197 +83,898 @@ typedef std::map< std::string, EntityVec >::value_type     RelationMap_pair ;
 class Entity
 {
   private :
-    static const std::string Unknown;
-
     uint32_t       _id ;
-    MetaMap        _meta ;
+    uint32_t       _hub_degree ;  // degree at which a relation gets a hash index
+    uint32_t       _slot ;        // dense position in the owning EntityMgr
+    SpinLock       _lock ;        // sits in padding; see lock()
+    bool           _erased ;      // a free slot in the owning EntityMgr
+    std::atomic<uint32_t> _inbound ;  // links into this entity, any type, self links included
+    MetaIndex     *_index ;       // owning EntityMgr's meta index, if any
+    ClosureCache  *_closures ;    // owning EntityMgr's closure cache, if any
+    ChangeLog     *_log ;         // owning EntityMgr's change log, if any
+    MetaSet        _meta ;
     RelationMap    _links ;
+    std::unique_ptr<HubIndex> _hubs ;  // only allocated once some relation is a hub
 
-    bool           vec_exists( EntityVec &v, Entity *e )
+    bool           vec_exists( const EntityVec &v, Entity *e ) const
                    {  return (std::find(v.begin(), v.end(), e) != v.end()) ;
                    }
-    bool           vec_exists( MetaVec &v, const std::string &e )
-                   {  return (std::find(v.begin(), v.end(), e) != v.end()) ;
+    // the hash set of 'type_', if it has one; never builds it, so readers
+    // can call it alongside each other
+    const EntitySet *find_hub( RelationType type_ ) const
+                   {
+                     if (!_hubs)
+                       return nullptr ;
+                     HubIndex::const_iterator  it = _hubs->find( type_ ) ;
+                     return (it == _hubs->end()) ? nullptr : &(*it).second ;
+                   }
+    // the hash set of 'type_', built once 'v' reaches the hub degree; only
+    // add_link calls it
+    EntitySet     *hub( RelationType type_, EntityVec &v )
+                   {
+                     if (v.size() < _hub_degree)
+                       return nullptr ;
+                     if (!_hubs)
+                       _hubs.reset( new HubIndex() ) ;
+                     HubIndex_iter  it = _hubs->find( type_ ) ;
+                     if (it == _hubs->end())
+                     {
+                       it = _hubs->insert( HubIndex::value_type( type_, EntitySet( v.begin(), v.end() ))).first ;
+                       BOOST_RELATIONS_COUNT( hub_promotions, 1 ) ;
+                     }
+                     return &(*it).second ;
+                   }
+    bool           add_link( RelationType type_, Entity &other )
+                   {
+                     RelationMap_iter  it = _links.find( type_ ) ;
+                     if (it == _links.end())
+                     {
+                       _links.insert(RelationMap_pair( type_, { &other } )) ;
+                       other._inbound.fetch_add( 1, std::memory_order_relaxed ) ;
+                       return true ;
+                     }
+
+                     EntitySet  *set = hub( type_, (*it).second ) ;
+                     if (set != nullptr)
+                     {
+                       if (set->insert( &other ).second == false)
+                         return false ;
+                     }
+                     else if (vec_exists( (*it).second, &other ))
+                       return false ;
+                     (*it).second.push_back( &other ) ;
+                     other._inbound.fetch_add( 1, std::memory_order_relaxed ) ;
+                     return true ;
+                   }
+    bool           remove_link( RelationType type_, Entity &other )
+                   {
+                     RelationMap_iter  it = _links.find( type_ ) ;
+                     if (it == _links.end())
+                       return false ;
+
+                     EntityVec       &v   = (*it).second ;
+                     EntityVec_iter   pos = std::find( v.begin(), v.end(), &other ) ;
+                     if (pos == v.end())
+                       return false ;
+                     v.erase( pos ) ;
+                     other._inbound.fetch_sub( 1, std::memory_order_relaxed ) ;
+
+                     if (_hubs)
+                     {
+                       // below the threshold links stop going into the set, so drop it
+                       HubIndex_iter  h = _hubs->find( type_ ) ;
+                       if (h != _hubs->end() && v.size() < _hub_degree)
+                         _hubs->erase( h ) ;
+                       else if (h != _hubs->end())
+                         (*h).second.erase( &other ) ;
+                     }
+                     if (v.empty())
+                       _links.erase( it ) ;
+                     else if (v.size() * 4 <= v.capacity())
+                       v.shrink_to_fit() ;
+                     return true ;
                    }
+    void           changed( RelationType type_ ) ;  // defined in closure_cache.hpp
+    void           logged( bool added, RelationType type_, const Entity &other ) ;  // defined in change_log.hpp
+    void           logged( MetaKey name, MetaValue value ) ;
+
+    friend class EntityMgr ;
 
   public  :
-                   Entity( uint32_t id_ ) 
+    static const uint32_t no_index = 0xffffffff ;
+
+    // name() of an entity without a first name; a function-local static so
+    // the header can be included from any number of translation units
+    static const std::string &unknown()
                    {
-                     _id = id_ ;
+                     static const std::string  s( "unknown" ) ;
+                     return s ;
                    }
 
-    bool           is_linked( const std::string &type_, Entity &other ) 
+                   Entity( uint32_t id_, uint32_t hub_degree_ = no_index, uint32_t slot_ = 0, MetaIndex *index_ = nullptr,
+                           ClosureCache *closures_ = nullptr, ChangeLog *log_ = nullptr ) 
+                   {
+                     _id         = id_ ;
+                     _hub_degree = hub_degree_ ;
+                     _slot       = slot_ ;
+                     _index      = index_ ;
+                     _closures   = closures_ ;
+                     _log        = log_ ;
+                     _erased     = false ;
+                     _inbound.store( 0, std::memory_order_relaxed ) ;
+                   }
+
+    bool           is_linked( RelationType type_, Entity &other ) 
                    {
                      RelationMap_iter  it = _links.find( type_ ) ;
                      if (it == _links.end())
                        return false ;
+                     const EntitySet  *set = find_hub( type_ ) ;
+                     if (set != nullptr)
+                       return set->count( &other ) != 0 ;
                      return (vec_exists( (*it).second, &other )) ;
                    }
+    bool           is_linked( const std::string &type_, Entity &other ) 
+                   {
+                     RelationType  t = RelationType::find( type_ ) ;
+                     return t.valid() && is_linked( t, other ) ;
+                   }
+    void           link( RelationType type_, Entity &other ) 
+                   {
+                     BOOST_RELATIONS_TIME( link_ns ) ;
+                     BOOST_RELATIONS_COUNT( links, 1 ) ;
+                     if (add_link( type_, other ) == false)
+                       return ;
+                     BOOST_RELATIONS_COUNT( links_added, 1 ) ;
+                     if (_closures != nullptr)
+                       changed( type_ ) ;
+                     if (_log != nullptr)
+                       logged( true, type_, other ) ;
+                   }
     void           link( const std::string &type_, Entity &other ) 
                    {
-                     RelationMap_iter  it = _links.find( type_ ) ;
-                     if (it == _links.end())
-                       _links.insert(RelationMap_pair( type_, { &other } )) ;
-                     else if (vec_exists( (*it).second, &other ) == false)
-                       (*it).second.push_back( &other ) ;
+                     link( RelationType( type_ ), other ) ;
+                   }
+    // O(degree of 'type_'); false if there was no such link.  reciprocal
+    // links are left alone, see ReciprocalMgr::unlink_with_reciprocals
+    bool           unlink( RelationType type_, Entity &other )
+                   {
+                     if (remove_link( type_, other ) == false)
+                       return false ;
+                     BOOST_RELATIONS_COUNT( unlinks, 1 ) ;
+                     if (_closures != nullptr)
+                       changed( type_ ) ;
+                     if (_log != nullptr)
+                       logged( false, type_, other ) ;
+                     return true ;
+                   }
+    bool           unlink( const std::string &type_, Entity &other )
+                   {
+                     RelationType  t = RelationType::find( type_ ) ;
+                     return t.valid() && unlink( t, other ) ;
+                   }
+    // drop every link to 'other', whatever its type
+    void           unlink( Entity &other )
+                   {
+                     for (size_t i = 0; i < _links.size(); )
+                     {
+                       RelationMap_iter  it = _links.begin() + i ;
+                       RelationType      t  = (*it).first ;
+                       bool              gone = ((*it).second.size() == 1) && ((*it).second[0] == &other) ;
+
+                       unlink( t, other ) ;
+                       if (!gone)
+                         i++ ;
+                     }
+                   }
+    void           meta( MetaKey name, MetaValue value ) 
+                   {
+                     BOOST_RELATIONS_TIME( meta_ns ) ;
+                     if (_meta.insert( name, value ) == false)
+                       return ;
+                     BOOST_RELATIONS_COUNT( meta_writes, 1 ) ;
+                     if (_index != nullptr)
+                       _index->add( name, value, _id, _slot ) ;
+                     if (_log != nullptr)
+                       logged( name, value ) ;
+                   }
+    void           meta( MetaKey name, const std::string &value ) 
+                   {
+                     meta( name, MetaValue( value )) ;
                    }
     void           meta( const std::string &name, const std::string &value ) 
                    {
-                     MetaMap_iter  it = _meta.find( name ) ;
-                     if (it == _meta.end())
-                       _meta.insert(MetaMap_pair( name, { value } )) ;
-                     else if (vec_exists( (*it).second, value ) == false)
-                       (*it).second.push_back( value ) ;
+                     meta( MetaKey( name ), MetaValue( value )) ;
                    }
     void           meta( const std::vector< std::string > &pairs ) 
                    {
                      std::vector< std::string >::const_iterator  it ;
                      for (it = pairs.begin(); it != pairs.end(); it++)
                      {
-                       std::string  key( (*it) ) ;
+                       MetaKey  key( (*it) ) ;
                        it++ ;
                        if (it == pairs.end())
                          break ;
-                       std::string  value( (*it) ) ;
-                       meta( key, value ) ;
+                       meta( key, (*it) ) ;
                      }
                    }
-    MetaVec       *get_meta( const std::string &type_ ) 
+    // the values under 'type_', oldest first; empty if there are none.
+    // valid until the next meta() on this entity
+    MetaSpan       get_meta( MetaKey type_ ) const
                    {
-                     MetaMap_iter  it = _meta.find( type_ ) ;
-                     return (it == _meta.end()) ? nullptr : &(*it).second ;
+                     return _meta.find( type_ ) ;
                    }
-    EntityVec     *relation( const std::string &type_ ) 
+    MetaSpan       get_meta( const std::string &type_ ) const
+                   {
+                     return get_meta( MetaKey::find( type_ )) ;
+                   }
+    bool           has_meta( MetaKey type_, MetaValue value ) const
+                   {
+                     return _meta.contains( type_, value ) ;
+                   }
+    bool           has_meta( const std::string &type_, const std::string &value ) const
+                   {
+                     MetaKey    k = MetaKey::find( type_ ) ;
+                     MetaValue  v = MetaValue::find( value ) ;
+                     return k.valid() && v.valid() && has_meta( k, v ) ;
+                   }
+    EntityVec     *relation( RelationType type_ ) 
                    {
                      RelationMap_iter  it = _links.find( type_ ) ;
                      return (it == _links.end()) ? nullptr : &(*it).second ;
                    }
+    EntityVec     *relation( const std::string &type_ ) 
+                   {
+                     RelationType  t = RelationType::find( type_ ) ;
+                     return t.valid() ? relation( t ) : nullptr ;
+                   }
     RelationMap   &relations() { return _links ; }
+    const MetaSet &meta_data() const { return _meta ; }
 
-    const std::string &name() { 
-                     MetaMap_iter  it = _meta.find( "firstname" ) ; 
-                     if ((it == _meta.end()) || ((*it).second.size() == 0))
-                       return Unknown ;
-                     return ((*it).second)[0] ;
+    // links across every relation
+    size_t         degree() const
+                   {
+                     size_t  n = 0 ;
+                     for (RelationMap::const_iterator it = _links.begin(); it != _links.end(); it++)
+                       n += (*it).second.size() ;
+                     return n ;
                    }
 
-    void           find_relations( EntityRelationMap &data, const std::string &path )
+    // add this entity's counts, degree and heap footprint to 'ps'
+    void           account( PopulationStats &ps ) const
                    {
-                     EntityRelationMap_iter   dit ;
-                     RelationMap_iter         it ;
+                     size_t  d = degree() ;
 
-                     // parent
-                     if ((it = _links.find( "parent" )) != _links.end())
-                     {
-                       for (EntityVec_iter eit = (*it).second.begin(); eit != (*it).second.end(); eit++)
-                       {
-                         dit = data.find( (*eit) ) ;
-                         if (dit == data.end())
-                         {
-                           // new entity
-                           data.insert( EntityRelationMap_pair( (*eit), path + 'c' )) ;
-                           (*eit)->find_relations( data, path + 'c' ) ;
-                         }
-                       }
-                     }
+                     ps.entities++ ;
+                     ps.relation_types += _links.size() ;
+                     ps.links          += d ;
+                     ps.add_degree( d, _id ) ;
 
-                     // child
-                     if ((it = _links.find( "child" )) != _links.end())
-                     {
-                       for (EntityVec_iter eit = (*it).second.begin(); eit != (*it).second.end(); eit++)
-                       {
-                         dit = data.find( (*eit) ) ;
-                         if (dit == data.end())
-                         {
-                           // new entity
-                           data.insert( EntityRelationMap_pair( (*eit), path + 'p' )) ;
-                           (*eit)->find_relations( data, path + 'p' ) ;
-                         }
-                       }
-                     }
+                     ps.link_bytes += _links.capacity() * sizeof(RelationMap_pair) ;
+                     for (RelationMap::const_iterator it = _links.begin(); it != _links.end(); it++)
+                       ps.link_bytes += (*it).second.capacity() * sizeof(Entity*) ;
 
-                     // sibling
-                     if ((it = _links.find( "sibling" )) != _links.end())
+                     if (_hubs)
                      {
-                       for (EntityVec_iter eit = (*it).second.begin(); eit != (*it).second.end(); eit++)
-                       {
-                         dit = data.find( (*eit) ) ;
-                         if (dit == data.end())
-                         {
-                           // new entity
-                           data.insert( EntityRelationMap_pair( (*eit), path + 's' )) ;
-                           (*eit)->find_relations( data, path + 's' ) ;
-                         }
-                       }
+                       ps.hubs      += _hubs->size() ;
+                       ps.hub_bytes += sizeof(HubIndex) + _hubs->bucket_count() * sizeof(void*) ;
+                       for (HubIndex::const_iterator it = _hubs->begin(); it != _hubs->end(); it++)
+                         ps.hub_bytes += hash_node_bytes + sizeof(HubIndex::value_type)
+                                       + (*it).second.bucket_count() * sizeof(void*)
+                                       + (*it).second.size() * (hash_node_bytes + sizeof(Entity*)) ;
                      }
 
-                     // spouse
-                     if ((it = _links.find( "spouse" )) != _links.end())
-                     {
-                       for (EntityVec_iter eit = (*it).second.begin(); eit != (*it).second.end(); eit++)
-                       {
-                         dit = data.find( (*eit) ) ;
-                         if (dit == data.end())
-                         {
-                           // new entity
-                           data.insert( EntityRelationMap_pair( (*eit), path + 'S' )) ;
-                           // stop traversing at spouse
-//                           (*eit)->find_relations( data, path + 's' ) ;
-                         }
-                       }
-                     }
+                     // the inline pairs are part of entity_bytes
+                     ps.meta_values += _meta.size() ;
+                     ps.meta_bytes  += _meta.heap_bytes() ;
                    }
-    void           find_relations( EntityRelationMap &data )
-                   {
-                     std::string  path( "" ) ;
-                     find_relations( data, path ) ;
+
+    const std::string &name() { 
+                     static const MetaKey  firstname( "firstname" ) ;
+                     MetaSpan  values = _meta.find( firstname ) ;
+                     if (values.empty())
+                       return unknown() ;
+                     return values[0].value.str() ;
                    }
 
+    // relation traversal; defined in traversal.hpp
+    template <typename Visitor>
+    void           find_relations( const TraversalSpec &spec, EntityScratch &scratch, uint32_t max_depth, Visitor visit ) ;
+    template <typename Visitor>
+    void           find_relations( EntityScratch &scratch, uint32_t max_depth, Visitor visit ) ;
+    void           find_relations( EntityHitVec &out, EntityScratch &scratch, uint32_t max_depth ) ;
+    void           find_relations( EntityRelationMap &data, const std::string &path ) ;
+    void           find_relations( EntityRelationMap &data ) ;
+
     uint32_t       id() const { return _id ; }
+    uint32_t       slot() const { return _slot ; }
+    bool           erased() const { return _erased ; }
+    void           meta_index( MetaIndex *index_ ) { _index = index_ ; }
+    void           closure_cache( ClosureCache *closures_ ) { _closures = closures_ ; }
+    void           change_log( ChangeLog *log_ ) { _log = log_ ; }
+
+    // link() and meta() are not synchronised.  loader threads sharing
+    // entities take this lock around them (std::lock_guard<Entity> works),
+    // or lock both endpoints with lock_pair()
+    void           lock()     { _lock.lock() ; }
+    bool           try_lock() { return _lock.try_lock() ; }
+    void           unlock()   { _lock.unlock() ; }
+
+    // writes out the change log's batch once it is full.  link() and meta()
+    // only append to it, since they may run under the locks above; call
+    // this once they are released.  unlock_pair() does.  defined in
+    // change_log.hpp
+    void           spill_log() ;
 } ; // class Entity
 
-std::string const Entity::Unknown = std::string("unknown");
+// func:   lock_pair / unlock_pair
+// desc:   lock two entities in slot order so concurrent writers linking the
+//         same pair in opposite directions can't deadlock
+//
+inline void lock_pair( Entity &a, Entity &b )
+{
+  if (&a == &b)
+    a.lock() ;
+  else if (a.slot() < b.slot())
+  {
+    a.lock() ;
+    b.lock() ;
+  }
+  else
+  {
+    b.lock() ;
+    a.lock() ;
+  }
+} // :: lock_pair
+
+inline void unlock_pair( Entity &a, Entity &b )
+{
+  a.unlock() ;
+  if (&a != &b)
+    b.unlock() ;
+  a.spill_log() ;
+} // :: unlock_pair
 
-typedef std::map< uint32_t, Entity* >               EntityMap ;
-typedef std::map< uint32_t, Entity* >::iterator     EntityMap_iter ;
-typedef std::map< uint32_t, Entity* >::value_type   EntityMap_pair ;
+typedef BasicEntityIndex<Entity>              EntityMap ;
 
 // class:  EntityMgr
-// desc:   Entity manager class that contains and manages all the entities
+// desc:   Entity manager class that contains and manages all the entities.
+//         entities live in a slab owned by the manager (stable addresses,
+//         freed together); slab chunks and the id maps come from 'resource'.
+//         erase() destroys an entity in place and its slot is reused by the
+//         next one created.
+//         ids are spread over 'shard_count' shards by their low bits; each
+//         shard looks ids up through a direct array while they stay dense,
+//         falling back to a hash table for sparse ranges.  in concurrent
+//         mode every shard has its own lock, so loader threads only contend
+//         when they touch the same shard at the same moment
 //
 class EntityMgr
 {
+  public  :
+    static const uint32_t default_hub_degree = 64 ;
+    static const uint32_t shard_bits         = 4 ;
+    static const uint32_t shard_count        = 1 << shard_bits ;
+
+    // class:  iterator
+    // desc:   walks entities in slot order, yielding Entity&; erased slots
+    //         are skipped
+    //
+    class iterator
+    {
+      private :
+        const EntityMgr   *_mgr ;
+        uint32_t           _slot ;
+
+        void               skip()
+                           {
+                             if (_mgr->_free.empty())
+                               return ;
+                             while (_slot < _mgr->slots() && _mgr->at_slot( _slot )->erased())
+                               _slot++ ;
+                           }
+
+      public  :
+                           iterator( const EntityMgr *mgr_, uint32_t slot_ ) : _mgr( mgr_ ), _slot( slot_ ) { skip() ; }
+
+        Entity            &operator*  () const { return *_mgr->at_slot( _slot ) ; }
+        Entity            *operator-> () const { return _mgr->at_slot( _slot ) ; }
+        iterator          &operator++ () { _slot++ ; skip() ; return *this ; }
+        iterator           operator++ ( int ) { iterator  t( *this ) ; ++(*this) ; return t ; }
+        bool               operator== ( const iterator &o ) const { return _slot == o._slot ; }
+        bool               operator!= ( const iterator &o ) const { return _slot != o._slot ; }
+    } ; // class iterator
+
   private :
-    EntityMap           _entities ;
+    struct Shard
+    {
+      std::mutex        lock ;
+      EntityMap         index ;
+
+                        Shard( MemoryResource *resource_ ) : index( resource_ ) {}
+    } ;
+
+    MemoryResource     *_resource ;
+    Slab<Entity>        _slab ;
+    std::mutex          _slab_lock ;
+    std::vector<uint32_t> _free ;             // erased slots, reused first
+    std::unique_ptr<Shard> _shards[shard_count] ;
+    uint32_t            _hub_degree ;
+    bool                _concurrent ;
+    std::unique_ptr<MetaIndex> _meta_index ;  // created by index_meta()
+    std::unique_ptr<ClosureCache> _closures ; // created by cache_relations()
+    ChangeLog          *_log ;                // set by change_log(); not owned
+
+                        EntityMgr( const EntityMgr & ) ;
+    EntityMgr          &operator= ( const EntityMgr & ) ;
+
+    void                clear_closures() ;  // defined in closure_cache.hpp
+    void                logged_create( uint32_t id ) ;  // defined in change_log.hpp
+    void                logged_erase( uint32_t id, bool scan_all ) ;
+    void                logged_clear() ;
+    void                spill_log() ;
+
+    Shard              &shard( uint32_t id ) const { return *_shards[id & (shard_count - 1)] ; }
+    static uint32_t     local( uint32_t id ) { return id >> shard_bits ; }
+
+    Entity             *construct( uint32_t id )
+                        {
+                          if (_free.empty())
+                            return _slab.create( id, _hub_degree, (uint32_t)_slab.size(), _meta_index.get(), _closures.get(), _log ) ;
+                          uint32_t  slot = _free.back() ;
+                          _free.pop_back() ;
+                          return _slab.replace( slot, id, _hub_degree, slot, _meta_index.get(), _closures.get(), _log ) ;
+                        }
+    MetaIndex          &meta_index()
+                        {
+                          if (!_meta_index)
+                          {
+                            _meta_index.reset( new MetaIndex() ) ;
+                            for (iterator it = begin(); it != end(); it++)
+                              (*it).meta_index( _meta_index.get() ) ;
+                          }
+                          return *_meta_index ;
+                        }
+    // hand the existing values of 'key' to one part of the index, once
+    void                backfill_meta( MetaKey key, uint32_t part )
+                        {
+                          for (iterator it = begin(); it != end(); it++)
+                          {
+                            MetaSpan  values = (*it).get_meta( key ) ;
+                            for (const MetaPair *p = values.begin(); p != values.end(); p++)
+                              _meta_index->add( key, (*p).value, (*it).id(), (*it).slot(), part ) ;
+                          }
+                        }
+
+    // clear() without the log record; the destructor's path, which must
+    // neither log a clear nor touch a log that may already be gone
+    void                teardown()
+                        {
+                          for (uint32_t i = 0; i < shard_count; i++)
+                            _shards[i]->index.clear() ;
+                          _slab.clear() ;
+                          _free.clear() ;
+                          if (_meta_index)
+                            _meta_index->clear() ;
+                          if (_closures)
+                            clear_closures() ;
+                        }
+
+    Entity             *create( uint32_t id )
+                        {
+                          BOOST_RELATIONS_COUNT( creates, 1 ) ;
+                          if (_log != nullptr)
+                            logged_create( id ) ;
+                          if (_concurrent)
+                          {
+                            std::lock_guard<std::mutex>  guard( _slab_lock ) ;
+                            return construct( id ) ;
+                          }
+                          return construct( id ) ;
+                        }
 
   public  :
-                        EntityMgr() {}
+                        EntityMgr( Adjacency adjacency_ = Adjacency::indexed, uint32_t hub_degree_ = default_hub_degree,
+                                   MemoryResource *resource_ = MemoryResource::heap() )
+                        : _resource( resource_ ), _slab( resource_ ),
+                          _hub_degree( (adjacency_ == Adjacency::indexed) ? hub_degree_ : Entity::no_index ),
+                          _concurrent( false ), _log( nullptr )
+                        {
+                          for (uint32_t i = 0; i < shard_count; i++)
+                            _shards[i].reset( new Shard( resource_ )) ;
+                        }
+                       ~EntityMgr() ;
+
+    // destroys every entity; references handed out by get() become invalid
+    void                clear()
+                        {
+                          teardown() ;
+                          if (_log != nullptr)
+                            logged_clear() ;
+                        }
+
+    // make get() and find() safe to call from several threads.  switch it
+    // on before the loader threads start; Entity::link/meta still need the
+    // entity lock (ReciprocalMgr::link_with_reciprocals takes it)
+    void                concurrent( bool on ) { _concurrent = on ; }
+    bool                concurrent() const { return _concurrent ; }
+
+    // append every later create, link, unlink, meta, erase and clear to
+    // 'log_' (see change_log.hpp); nullptr stops logging.  attach it before
+    // loader threads start
+    void                change_log( ChangeLog *log_ )
+                        {
+                          _log = log_ ;
+                          for (iterator it = begin(); it != end(); it++)
+                            (*it).change_log( log_ ) ;
+                        }
+    ChangeLog          *change_log() const { return _log ; }
 
     Entity             &get( uint32_t id ) 
                         {
-                          EntityMap_iter  it = _entities.find( id ) ;
-                          if (it == _entities.end())
+                          BOOST_RELATIONS_TIME( get_ns ) ;
+                          BOOST_RELATIONS_COUNT( gets, 1 ) ;
+                          Shard  &sh = shard( id ) ;
+                          Entity  *e ;
+                          if (_concurrent)
+                          {
+                            std::lock_guard<std::mutex>  guard( sh.lock ) ;
+                            e = sh.index.find( local( id )) ;
+                            if (e == nullptr)
+                            {
+                              e = create( id ) ;
+                              sh.index.insert( local( id ), e ) ;
+                            }
+                          }
+                          else
+                          {
+                            e = sh.index.find( local( id )) ;
+                            if (e == nullptr)
+                            {
+                              e = create( id ) ;
+                              sh.index.insert( local( id ), e ) ;
+                            }
+                          }
+                          // the create record went in under the shard lock; any I/O waits until now
+                          if (_log != nullptr)
+                            spill_log() ;
+                          return *e ;
+                        }
+
+    // non-inserting lookup; nullptr if 'id' doesn't exist
+    Entity             *find( uint32_t id ) const
+                        {
+                          Shard  &sh = shard( id ) ;
+                          if (_concurrent)
+                          {
+                            std::lock_guard<std::mutex>  guard( sh.lock ) ;
+                            return sh.index.find( local( id )) ;
+                          }
+                          return sh.index.find( local( id )) ;
+                        }
+
+    // size the direct indexes for ids [0, max_id] ahead of a bulk load
+    void                reserve( uint32_t max_id )
+                        {
+                          for (uint32_t i = 0; i < shard_count; i++)
+                            _shards[i]->index.reserve( local( max_id )) ;
+                        }
+
+    // destroy 'id', first removing it from the links of every entity that
+    // links to it.  its neighbours are cleaned up first, so with reciprocal
+    // links the cost is the sum of their degrees; if links into 'id' remain
+    // after that (one-way links from entities it doesn't link back to) the
+    // whole population is scanned, as it always is with 'scan_all'.  no
+    // link is ever left on the slot, which is freed and reused; references
+    // to the entity become invalid.  not safe while other threads use the
+    // manager
+    bool                erase( uint32_t id, bool scan_all = false )
+                        {
+                          Entity  *e = find( id ) ;
+                          if (e == nullptr)
+                            return false ;
+
+                          // its own links go with it
+                          RelationMap  &links = e->relations() ;
+                          EntityVec     neighbours ;
+                          uint32_t      self = 0 ;
+                          for (RelationMap_iter it = links.begin(); it != links.end(); it++)
+                          {
+                            for (EntityVec_iter n = (*it).second.begin(); n != (*it).second.end(); n++)
+                            {
+                              if ((*n) == e)
+                                self++ ;
+                              else
+                              {
+                                (*n)->_inbound.fetch_sub( 1, std::memory_order_relaxed ) ;
+                                neighbours.push_back( *n ) ;
+                              }
+                            }
+                            if (_closures)
+                              e->changed( (*it).first ) ;
+                          }
+
+                          // each neighbour drops its back-edges once, however
+                          // many relations lead to it
+                          if (!scan_all)
+                          {
+                            std::sort( neighbours.begin(), neighbours.end() ) ;
+                            neighbours.erase( std::unique( neighbours.begin(), neighbours.end() ), neighbours.end() ) ;
+                            for (EntityVec_iter n = neighbours.begin(); n != neighbours.end(); n++)
+                              (*n)->unlink( *e ) ;
+                          }
+                          if (scan_all || e->_inbound.load( std::memory_order_relaxed ) > self)
+                          {
+                            for (iterator it = begin(); it != end(); it++)
+                            {
+                              if (&(*it) != e)
+                                (*it).unlink( *e ) ;
+                            }
+                          }
+                          if (_meta_index)
                           {
-                            Entity  *e = new Entity( id ) ;
-                            _entities.insert(EntityMap_pair( id, e )) ;
-                            return *e ;
+                            const MetaSet  &meta = e->meta_data() ;
+                            for (const MetaPair *p = meta.begin(); p != meta.end(); p++)
+                              _meta_index->remove( (*p).key, (*p).value, id, e->slot() ) ;
                           }
-                          
-                          return *(*it).second ;
+
+                          uint32_t  slot = e->slot() ;
+                          shard( id ).index.erase( local( id )) ;
+                          _slab.replace( slot, id, (uint32_t)Entity::no_index, slot )->_erased = true ;
+                          _free.push_back( slot ) ;
+                          if (_log != nullptr)
+                          {
+                            logged_erase( id, scan_all ) ;
+                            spill_log() ;
+                          }
+                          return true ;
                         }
 
-    uint32_t            size() const { return _entities.size(); }
+    // iteration yields Entity& in slot order.  not safe while other
+    // threads are creating entities
+    iterator            begin() const { return iterator( this, 0 ) ; }
+    iterator            end()   const { return iterator( this, slots() ) ; }
+
+    // closures for many roots at once, spread over 'pool'; results[i] holds
+    // the hits for sources[i] (empty for unknown ids).  defined in
+    // traversal.hpp.  the graph must not be modified while this runs
+    void                find_relations( const std::vector<uint32_t> &sources, std::vector<EntityHitVec> &results,
+                                        const TraversalSpec &spec, uint32_t max_depth, ThreadPool &pool ) const ;
+    void                find_relations( const std::vector<uint32_t> &sources, std::vector<EntityHitVec> &results,
+                                        uint32_t max_depth = PackedPath::max_steps ) const ;
+
+    // dense single-root traversal: visited tracking by slot with an O(1)
+    // reset, results as (slot, path) pairs; see at_slot().  defined in
+    // traversal.hpp
+    void                find_relations( uint32_t id, SlotHitVec &out, SlotScratch &scratch,
+                                        uint32_t max_depth = PackedPath::max_steps ) const ;
+    void                find_relations( uint32_t id, const TraversalSpec &spec, SlotHitVec &out, SlotScratch &scratch,
+                                        uint32_t max_depth = PackedPath::max_steps ) const ;
+
+    // shortest path from 'from' to 'to' under 'spec', at most 'max_depth'
+    // steps.  runs a bidirectional BFS when spec.reversible() (every rule
+    // names its inverse and none is hop-capped), otherwise a forward BFS
+    // that stops at 'to'.  false if there is no such path.  defined in
+    // traversal.hpp
+    bool                find_path( uint32_t from, uint32_t to, const TraversalSpec &spec, RelationPath &out,
+                                   PathScratch &scratch, uint32_t max_depth = PackedPath::max_steps ) const ;
+    bool                find_path( uint32_t from, uint32_t to, RelationPath &out, PathScratch &scratch,
+                                   uint32_t max_depth = PackedPath::max_steps ) const ;
+
+    // keep find_relations results per root from now on.  each Entity::link
+    // drops only the cached closures that walked through the linking entity.
+    // call before loader threads start; defined in closure_cache.hpp
+    void                cache_relations( const TraversalSpec &spec, uint32_t max_depth ) ;
+    void                cache_relations() ;
+    void                uncache_relations() ;
+    bool                relations_cached() const { return (bool)_closures ; }
+    uint32_t            closures_cached() const ;
+    uint64_t            closure_readers() const ;
+
+    // the closure of 'id' under the cached spec, from the cache when it is
+    // current.  without a cache this is find_relations( id, out, scratch )
+    void                cached_relations( uint32_t id, SlotHitVec &out, SlotScratch &scratch ) const ;
+
+    // entities are numbered 0 .. slots()-1; at_slot() may return an erased
+    // entity once erase() has been used
+    uint32_t            slots() const { return (uint32_t)_slab.size() ; }
+    Entity             *at_slot( uint32_t slot ) const { return _slab.at( slot ) ; }
+
+    // maintain an inverted index for 'key' from now on; existing values are
+    // indexed once here.  call before loader threads start
+    void                index_meta( MetaKey key )
+                        {
+                          if (meta_index().enable( key ))
+                            backfill_meta( key, MetaIndex::postings_part ) ;
+                        }
+    void                index_meta( const std::string &key ) { index_meta( MetaKey( key )) ; }
+    bool                meta_indexed( MetaKey key ) const { return _meta_index && _meta_index->enabled( key ) ; }
+
+    // keep 'key' as a column of value ids by slot from now on, so the
+    // select_meta() scans read 4 sequential bytes per entity instead of
+    // visiting each one.  existing values are copied in once here.  call
+    // before loader threads start
+    void                columnar_meta( MetaKey key )
+                        {
+                          if (meta_index().enable_column( key ))
+                            backfill_meta( key, MetaIndex::column_part ) ;
+                        }
+    void                columnar_meta( const std::string &key ) { columnar_meta( MetaKey( key )) ; }
+    bool                meta_columnar( MetaKey key ) const { return _meta_index && _meta_index->column( key ) != nullptr ; }
+
+    // the slots of the entities with 'value' (or any of 'values') under
+    // 'key', as a Selection of slots() bits.  a column scan when the key is
+    // columnar, otherwise a pass over the population.  not safe while
+    // other threads write meta
+    void                select_meta( MetaKey key, MetaValue value, Selection &out ) const
+                        {
+                          select_meta( key, std::vector<MetaValue>( 1, value ), out ) ;
+                        }
+    void                select_meta( MetaKey key, const std::vector<MetaValue> &wanted, Selection &out ) const
+                        {
+                          const MetaColumn       *col = _meta_index ? _meta_index->column( key ) : nullptr ;
+                          std::vector<MetaValue>  values ;
+
+                          out.reset( slots() ) ;
+                          for (size_t v = 0; v < wanted.size(); v++)
+                          {
+                            if (wanted[v].valid())  // MetaValue::find() misses match nothing
+                              values.push_back( wanted[v] ) ;
+                          }
+                          if (values.empty())
+                            return ;
+                          if (col != nullptr)
+                          {
+                            if (values.size() == 1)
+                              col->select( values[0], out.words() ) ;
+                            else
+                              col->select( values, out.words() ) ;
+                            return ;
+                          }
+                          for (iterator it = begin(); it != end(); it++)
+                          {
+                            for (size_t v = 0; v < values.size(); v++)
+                            {
+                              if ((*it).has_meta( key, values[v] ))
+                              {
+                                out.set( (*it).slot() ) ;
+                                break ;
+                              }
+                            }
+                          }
+                        }
+    void                select_meta( const std::string &key, const std::string &value, Selection &out ) const
+                        {
+                          MetaKey    k = MetaKey::find( key ) ;
+                          MetaValue  v = MetaValue::find( value ) ;
+                          if (!k.valid() || !v.valid())
+                            out.reset( slots() ) ;
+                          else
+                            select_meta( k, v, out ) ;
+                        }
+    // values for which 'pred( const std::string & )' holds.  the predicate
+    // runs once per distinct value in the pool rather than once per entity
+    template <typename Pred>
+    void                select_meta_if( MetaKey key, Pred pred, Selection &out ) const
+                        {
+                          std::vector<MetaValue>  values ;
+                          uint32_t                pool = MetaValue::table().size() ;
+
+                          for (uint32_t v = 0; v < pool; v++)
+                          {
+                            if (pred( MetaValue( v ).str() ))
+                              values.push_back( MetaValue( v )) ;
+                          }
+                          select_meta( key, values, out ) ;
+                        }
+
+    // ids of the selected entities in slot order, e.g. as the sources of a
+    // batch find_relations()
+    void                selected( const Selection &sel, IdVec &out ) const
+                        {
+                          out.clear() ;
+                          out.reserve( sel.count() ) ;
+                          sel.for_each( [&]( uint32_t slot )
+                                        {
+                                          Entity  *e = at_slot( slot ) ;
+                                          if (!e->erased())
+                                            out.push_back( e->id() ) ;
+                                        }) ;
+                        }
+
+    // ascending ids of the entities with 'value' under 'key'.  uses the
+    // index when there is one, otherwise scans the population
+    void                find_by_meta( MetaKey key, const std::string &value, IdVec &out ) const
+                        {
+                          if (meta_indexed( key ))
+                          {
+                            IndexSpan  ids = _meta_index->find( key, value ) ;
+                            out.assign( ids.begin(), ids.end() ) ;
+                            return ;
+                          }
+                          MetaTermVec  terms( 1, MetaTerm( key, value )) ;
+                          scan_meta( terms, out ) ;
+                        }
+    void                find_by_meta( const std::string &key, const std::string &value, IdVec &out ) const
+                        {
+                          MetaKey  k = MetaKey::find( key ) ;
+                          out.clear() ;
+                          if (k.valid())
+                            find_by_meta( k, value, out ) ;
+                        }
+    // entities matching every term (an AND query); posting lists are
+    // intersected when all keys are indexed
+    void                find_by_meta( const MetaTermVec &terms, IdVec &out ) const
+                        {
+                          if (!_meta_index || !_meta_index->find( terms, out ))
+                            scan_meta( terms, out ) ;
+                        }
+    void                scan_meta( const MetaTermVec &terms, IdVec &out ) const
+                        {
+                          std::vector<MetaValue>  values ;
+
+                          out.clear() ;
+                          for (MetaTermVec_iter t = terms.begin(); t != terms.end(); t++)
+                          {
+                            values.push_back( MetaValue::find( (*t).second )) ;
+                            if (!values.back().valid())
+                              return ;  // a value nobody has
+                          }
+                          for (iterator it = begin(); it != end(); it++)
+                          {
+                            bool  all = true ;
+                            for (size_t t = 0; t < terms.size() && all; t++)
+                              all = (*it).has_meta( terms[t].first, values[t] ) ;
+                            if (all)
+                              out.push_back( (*it).id() ) ;
+                          }
+                          std::sort( out.begin(), out.end() ) ;
+                        }
+
+    MemoryResource     *resource() const { return _resource ; }
+    uint32_t            size() const { return slots() - (uint32_t)_free.size() ; }
+
+    // (entity, relation type) pairs, a full scan; see total_links()
     uint32_t            total_relations()
                         {
                           uint32_t total = 0;
-                          for (EntityMap_iter it = _entities.begin(); it != _entities.end(); it++)
-                            total += (*(*it).second).relations().size();
+                          for (iterator it = begin(); it != end(); it++)
+                            total += (*it).relations().size();
                           return total;
                         }
+    // links over every entity and relation, a full scan
+    uint64_t            total_links() const
+                        {
+                          uint64_t  total = 0 ;
+                          for (iterator it = begin(); it != end(); it++)
+                            total += (*it).degree() ;
+                          return total ;
+                        }
+
+    // counts, degree distribution and bytes per structure; a full scan, so
+    // not for the hot path.  not safe while other threads modify the manager
+    void                population_stats( PopulationStats &ps ) const
+                        {
+                          ps.clear() ;
+                          for (iterator it = begin(); it != end(); it++)
+                            (*it).account( ps ) ;
+
+                          ps.entity_bytes = _slab.capacity() * sizeof(Entity) + _free.capacity() * sizeof(uint32_t) ;
+                          for (uint32_t i = 0; i < shard_count; i++)
+                            ps.id_index_bytes += sizeof(Shard) + _shards[i]->index.memory_bytes() ;
+                          if (_meta_index)
+                            ps.meta_index_bytes = sizeof(MetaIndex) + _meta_index->memory_bytes() ;
+                          ps.value_pool_bytes = MetaValue::table().memory_bytes() ;
+                        }
 } ; // class EntityMgr
 
+typedef EntityMgr::iterator                   EntityMap_iter ;
+
 }} ; // namespace
 
+#include <boost/relations/traversal.hpp>
+#include <boost/relations/change_log.hpp>
+
 #endif
 
 
@@ -0,0 +1,232 @@
+/*!
+  @file       entity_index.hpp
+  @brief      Id to entity index: direct-indexed for dense ids, hashed for sparse
+
+  @author     Robert McInnis
+  @date       september 21, 2016
+  @par        copyright (c) 2016 Solid ICE Technologies, Inc.  All rights reserved.
+
+  Distributed under the Boost Software License, Version 1.0. (See accompanying
+  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+*/
+#ifndef ENTITY_INDEX_HPP
+#define ENTITY_INDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <boost/relations/arena.hpp>
+
+namespace boost { namespace relations {
+
+// class:  BasicEntityIndex
+// desc:   maps uint32_t ids to T*.  ids below the direct bound are a single
+//         array load; ids far beyond the population size (sparse ranges) go
+//         to an open-addressing, linear-probing table.  the direct array only
+//         grows while it stays within ~2x the number of entries, so a few
+//         huge ids can't blow it up
+//
+template <typename T>
+class BasicEntityIndex
+{
+  private :
+    struct Slot
+    {
+      uint32_t     id ;
+      T           *ptr ;      // nullptr == empty
+    } ;
+
+    typedef std::vector< T*,   ResourceAllocator<T*> >    DirectVec ;
+    typedef std::vector< Slot, ResourceAllocator<Slot> >  SlotVec ;
+
+    DirectVec      _direct ;
+    SlotVec        _table ;   // power-of-two size, or empty
+    uint32_t       _shift ;   // 64 - log2( _table.size() )
+    size_t         _hashed ;  // entries in _table
+    size_t         _size ;
+
+    static const size_t min_direct = 1024 ;
+
+    // fibonacci hashing: the top bits of the product depend on every bit of
+    // 'id', so strided ids (multiples of a power of two) still spread
+    size_t         slot_of( uint32_t id ) const
+                   {
+                     return (size_t)(((uint64_t)id * 0x9E3779B97F4A7C15ull) >> _shift) ;
+                   }
+    void           hash_insert( uint32_t id, T *ptr )
+                   {
+                     if ((_hashed + 1) * 4 > _table.size() * 3)
+                       rehash( _table.empty() ? 16 : _table.size() * 2 ) ;
+                     size_t  i = slot_of( id ) ;
+                     while (_table[i].ptr != nullptr)
+                       i = (i + 1) & (_table.size() - 1) ;
+                     _table[i].id  = id ;
+                     _table[i].ptr = ptr ;
+                     _hashed++ ;
+                   }
+    void           rehash( size_t size )
+                   {
+                     SlotVec  old( _table.get_allocator() ) ;
+                     old.swap( _table ) ;
+                     Slot  empty = { 0, nullptr } ;
+                     _table.assign( size, empty ) ;
+                     _shift = 64 ;
+                     for (size_t n = size; n > 1; n >>= 1)
+                       _shift-- ;
+                     _hashed = 0 ;
+                     for (size_t i = 0; i < old.size(); i++)
+                     {
+                       if (old[i].ptr == nullptr)
+                         continue ;
+                       if (old[i].id < _direct.size())
+                         _direct[old[i].id] = old[i].ptr ;
+                       else
+                         hash_insert( old[i].id, old[i].ptr ) ;
+                     }
+                   }
+    void           grow_direct( size_t size )
+                   {
+                     _direct.resize( size, nullptr ) ;
+                     if (_hashed != 0)
+                       rehash( _table.size() ) ;  // pulls entries now in the direct range
+                   }
+
+  public  :
+    // class:  iterator
+    // desc:   forward iteration over every entry; direct range first (ascending
+    //         id), then the hashed range in table order
+    //
+    class iterator
+    {
+      private :
+        const BasicEntityIndex  *_index ;
+        size_t                   _pos ;
+
+        T                 *at() const
+                           {
+                             size_t  d = _index->_direct.size() ;
+                             return (_pos < d) ? _index->_direct[_pos] : _index->_table[_pos - d].ptr ;
+                           }
+        void               skip()
+                           {
+                             size_t  n = _index->_direct.size() + _index->_table.size() ;
+                             while (_pos < n && at() == nullptr)
+                               _pos++ ;
+                           }
+
+      public  :
+                           iterator( const BasicEntityIndex *index_, size_t pos_ ) : _index( index_ ), _pos( pos_ ) { skip() ; }
+
+        T                 &operator*  () const { return *at() ; }
+        T                 *operator-> () const { return at() ; }
+        iterator          &operator++ () { _pos++ ; skip() ; return *this ; }
+        iterator           operator++ ( int ) { iterator  t( *this ) ; ++(*this) ; return t ; }
+        bool               operator== ( const iterator &o ) const { return _pos == o._pos ; }
+        bool               operator!= ( const iterator &o ) const { return _pos != o._pos ; }
+    } ; // class iterator
+
+                   BasicEntityIndex( MemoryResource *resource_ = MemoryResource::heap() )
+                   : _direct( ResourceAllocator<T*>( resource_ )), _table( ResourceAllocator<Slot>( resource_ )),
+                     _shift( 64 ), _hashed( 0 ), _size( 0 ) {}
+
+    iterator       begin() const { return iterator( this, 0 ) ; }
+    iterator       end()   const { return iterator( this, _direct.size() + _table.size() ) ; }
+
+    size_t         size() const { return _size ; }
+    size_t         direct_size() const { return _direct.size() ; }
+    size_t         hashed_size() const { return _hashed ; }
+    size_t         memory_bytes() const { return _direct.capacity() * sizeof(T*) + _table.capacity() * sizeof(Slot) ; }
+
+    T             *find( uint32_t id ) const
+                   {
+                     if (id < _direct.size())
+                       return _direct[id] ;
+                     if (_hashed == 0)
+                       return nullptr ;
+                     for (size_t i = slot_of( id ); _table[i].ptr != nullptr; i = (i + 1) & (_table.size() - 1))
+                     {
+                       if (_table[i].id == id)
+                         return _table[i].ptr ;
+                     }
+                     return nullptr ;
+                   }
+
+    // caller guarantees 'id' is not present
+    void           insert( uint32_t id, T *ptr )
+                   {
+                     _size++ ;
+                     if (id >= _direct.size())
+                     {
+                       size_t  want  = (size_t)id + 1 ;
+                       size_t  bound = 2 * _size + min_direct ;
+                       if (want > bound)
+                       {
+                         hash_insert( id, ptr ) ;
+                         return ;
+                       }
+                       size_t  twice = 2 * _direct.size() ;
+                       grow_direct( (twice > want && twice <= bound) ? twice : want ) ;
+                     }
+                     _direct[id] = ptr ;
+                   }
+
+    // returns false if 'id' was not present.  hashed entries use backward
+    // shift deletion, so probe chains stay tombstone-free
+    bool           erase( uint32_t id )
+                   {
+                     if (id < _direct.size())
+                     {
+                       if (_direct[id] == nullptr)
+                         return false ;
+                       _direct[id] = nullptr ;
+                       _size-- ;
+                       return true ;
+                     }
+                     if (_hashed == 0)
+                       return false ;
+
+                     size_t  mask = _table.size() - 1 ;
+                     size_t  i    = slot_of( id ) ;
+                     for (; _table[i].ptr != nullptr; i = (i + 1) & mask)
+                     {
+                       if (_table[i].id == id)
+                         break ;
+                     }
+                     if (_table[i].ptr == nullptr)
+                       return false ;
+
+                     for (size_t j = (i + 1) & mask; _table[j].ptr != nullptr; j = (j + 1) & mask)
+                     {
+                       // entries whose home lies cyclically in (i, j] stay put
+                       size_t  k = slot_of( _table[j].id ) ;
+                       if ((i <= j) ? (i < k && k <= j) : (i < k || k <= j))
+                         continue ;
+                       _table[i] = _table[j] ;
+                       i = j ;
+                     }
+                     _table[i].ptr = nullptr ;
+                     _hashed-- ;
+                     _size-- ;
+                     return true ;
+                   }
+
+    // pre-size the direct range for ids [0, max_id]
+    void           reserve( uint32_t max_id )
+                   {
+                     if ((size_t)max_id + 1 > _direct.size())
+                       grow_direct( (size_t)max_id + 1 ) ;
+                   }
+
+    void           clear()
+                   {
+                     _direct.clear() ;
+                     _table.clear() ;
+                     _hashed = 0 ;
+                     _size   = 0 ;
+                   }
+} ; // class BasicEntityIndex
+
+}} ; // namespace
+
+#endif
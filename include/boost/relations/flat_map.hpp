@@ -0,0 +1,91 @@
+/*!
+  @file       flat_map.hpp
+  @brief      Sorted-vector associative container
+
+  @author     Robert McInnis
+  @date       september 21, 2016
+  @par        copyright (c) 2016 Solid ICE Technologies, Inc.  All rights reserved.
+
+  Distributed under the Boost Software License, Version 1.0. (See accompanying
+  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+*/
+#ifndef FLAT_MAP_HPP
+#define FLAT_MAP_HPP
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace boost { namespace relations {
+
+// class:  FlatMap
+// desc:   map interface over a single sorted vector of pairs.  an entity only
+//         has a handful of keys, so one contiguous block beats a tree node per
+//         key both in memory and in lookup cost
+//
+template <typename K, typename V>
+class FlatMap
+{
+  public  :
+    typedef K                                          key_type ;
+    typedef V                                          mapped_type ;
+    typedef std::pair<K, V>                            value_type ;
+    typedef typename std::vector<value_type>::iterator       iterator ;
+    typedef typename std::vector<value_type>::const_iterator const_iterator ;
+
+  private :
+    std::vector<value_type>  _data ;
+
+    struct KeyLess
+    {
+      bool         operator() ( const value_type &a, const K &b ) const { return a.first < b ; }
+    } ;
+
+  public  :
+                   FlatMap() {}
+
+    iterator       begin()       { return _data.begin() ; }
+    iterator       end()         { return _data.end() ; }
+    const_iterator begin() const { return _data.begin() ; }
+    const_iterator end()   const { return _data.end() ; }
+
+    size_t         size()  const { return _data.size() ; }
+    size_t         capacity() const { return _data.capacity() ; }
+    bool           empty() const { return _data.empty() ; }
+
+    iterator       lower_bound( const K &key )
+                   {
+                     return std::lower_bound( _data.begin(), _data.end(), key, KeyLess() ) ;
+                   }
+    iterator       find( const K &key )
+                   {
+                     iterator  it = lower_bound( key ) ;
+                     return (it != _data.end() && !(key < (*it).first)) ? it : _data.end() ;
+                   }
+    const_iterator find( const K &key ) const
+                   {
+                     return const_cast<FlatMap*>(this)->find( key ) ;
+                   }
+
+    std::pair<iterator, bool> insert( const value_type &v )
+                   {
+                     iterator  it = lower_bound( v.first ) ;
+                     if (it != _data.end() && !(v.first < (*it).first))
+                       return std::pair<iterator, bool>( it, false ) ;
+                     return std::pair<iterator, bool>( _data.insert( it, v ), true ) ;
+                   }
+    V             &operator[] ( const K &key )
+                   {
+                     iterator  it = lower_bound( key ) ;
+                     if (it == _data.end() || key < (*it).first)
+                       it = _data.insert( it, value_type( key, V() )) ;
+                     return (*it).second ;
+                   }
+    iterator       erase( iterator it ) { return _data.erase( it ) ; }
+    void           clear() { _data.clear() ; }
+    void           shrink_to_fit() { _data.shrink_to_fit() ; }
+} ; // class FlatMap
+
+}} ; // namespace
+
+#endif
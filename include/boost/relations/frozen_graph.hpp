@@ -0,0 +1,531 @@
+/*!
+  @file       frozen_graph.hpp
+  @brief      Immutable compressed sparse row (CSR) snapshot of an EntityMgr,
+              with a memory-mappable on-disk form
+
+  @author     Robert McInnis
+  @date       september 21, 2016
+  @par        copyright (c) 2016 Solid ICE Technologies, Inc.  All rights reserved.
+
+  Distributed under the Boost Software License, Version 1.0. (See accompanying
+  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+*/
+#ifndef FROZEN_GRAPH_HPP
+#define FROZEN_GRAPH_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/relations/entity.hpp>
+#include <boost/relations/mapped_file.hpp>
+#include <boost/relations/packed_path.hpp>
+#include <boost/relations/span.hpp>
+#include <boost/relations/string_ref.hpp>
+#include <boost/relations/traversal.hpp>
+#include <boost/relations/visited.hpp>
+
+namespace boost { namespace relations {
+
+// struct: FrozenRelation
+// desc:   one find_relations result on a snapshot
+//
+struct FrozenRelation
+{
+  uint32_t         index ;
+  PackedPath       path ;
+
+                   FrozenRelation( uint32_t index_, PackedPath path_ ) : index( index_ ), path( path_ ) {}
+} ; // struct FrozenRelation
+
+class FrozenGraph ;
+
+template <>
+struct GraphTraits<FrozenGraph>
+{
+  typedef uint32_t       node_type ;
+  typedef IndexSet       visited_type ;
+
+  static void            expand( const FrozenGraph &g, uint32_t index_, const TraversalSpec &spec, IndexSpan *out ) ;
+  static void            prepare( const FrozenGraph &g, visited_type &visited ) ;
+} ; // struct GraphTraits<FrozenGraph>
+
+typedef TraversalScratch<FrozenGraph>          FrozenScratch ;
+
+typedef std::vector<FrozenRelation>            FrozenRelationVec ;
+typedef std::vector<FrozenRelation>::iterator  FrozenRelationVec_iter ;
+
+// class:  FrozenGraph
+// desc:   read-mostly copy of an EntityMgr.  entities are addressed by a dense
+//         index (ascending id order); every relation type is one offsets array
+//         plus one targets array, every meta key one offsets array plus one
+//         column of value ids into a shared, de-duplicated string pool.
+//         nothing here allocates once built, and targets are sorted within a
+//         row so is_linked is a binary search.
+//
+//         all arrays are reached through raw pointers, so the same graph can
+//         be backed either by vectors (freeze) or by a mapped snapshot file
+//         (open) with no copying; see save() for the file layout
+//
+class FrozenGraph
+{
+  public  :
+    static const uint32_t npos    = 0xffffffff ;
+    static const uint32_t version = 1 ;
+
+  private :
+    struct Csr
+    {
+      const uint32_t  *offsets ;  // size() + 1 entries, or nullptr when unused
+      const uint32_t  *targets ;
+
+                       Csr() : offsets( nullptr ), targets( nullptr ) {}
+    } ;
+
+    // vectors behind the Csr pointers when built by freeze()
+    struct Owned
+    {
+      std::vector<uint32_t>                ids ;
+      std::vector< std::vector<uint32_t> > offsets ;
+      std::vector< std::vector<uint32_t> > targets ;
+      std::vector<uint64_t>                pool_offsets ;
+      std::string                          pool_chars ;
+    } ;
+
+    struct EntityIdLess
+    {
+      bool         operator() ( const Entity *a, const Entity *b ) const { return a->id() < b->id() ; }
+    } ;
+
+    Owned                  _owned ;
+    MappedFile             _file ;
+
+    const uint32_t        *_ids ;           // index -> entity id
+    uint32_t               _size ;
+    std::vector<Csr>       _relations ;     // by RelationType id
+    std::vector<Csr>       _meta ;          // by MetaKey id; targets are value ids
+    const uint64_t        *_pool_offsets ;  // value id -> [offsets[v], offsets[v + 1]) in _pool_chars
+    const char            *_pool_chars ;
+    uint32_t               _pool_size ;
+
+                   FrozenGraph( const FrozenGraph & ) ;
+    FrozenGraph   &operator= ( const FrozenGraph & ) ;
+
+    void           reset()
+                   {
+                     _owned = Owned() ;
+                     _file.close() ;
+                     _ids          = nullptr ;
+                     _size         = 0 ;
+                     _relations.clear() ;
+                     _meta.clear() ;
+                     _pool_offsets = nullptr ;
+                     _pool_chars   = nullptr ;
+                     _pool_size    = 0 ;
+                   }
+
+    static const char *magic() { return "BRELSNP" ; }  // 8 bytes with the NUL
+
+    // reads one named Csr section; offsets must cover size() + 1 rows and the
+    // last offset must match the target count
+    bool           read_csr( BinaryReader &in, std::string &name, Csr &csr ) const
+                   {
+                     size_t            len ;
+                     const char       *chars   = in.array<char>( len ) ;
+                     size_t            n_offsets ;
+                     const uint32_t   *offsets = in.array<uint32_t>( n_offsets ) ;
+                     size_t            n_targets ;
+                     const uint32_t   *targets = in.array<uint32_t>( n_targets ) ;
+
+                     if (!in.ok() || n_offsets != (size_t)_size + 1 || offsets[_size] != n_targets)
+                       return false ;
+                     name.assign( chars, len ) ;
+                     csr.offsets = offsets ;
+                     csr.targets = targets ;
+                     return true ;
+                   }
+    template <typename Sym>
+    static void    write_csrs( BinaryWriter &out, const std::vector<Csr> &csrs, uint32_t n )
+                   {
+                     for (size_t k = 0; k < csrs.size(); k++)
+                     {
+                       const Csr  &csr = csrs[k] ;
+                       if (csr.offsets == nullptr)
+                         continue ;
+                       const std::string  &name = Sym( (uint32_t)k ).str() ;
+                       out.chars( name.data(), name.size() ) ;
+                       out.array( csr.offsets, n + 1 ) ;
+                       out.array( csr.targets, csr.offsets[n] ) ;
+                     }
+                   }
+    static uint32_t used( const std::vector<Csr> &csrs )
+                   {
+                     uint32_t  count = 0 ;
+                     for (size_t k = 0; k < csrs.size(); k++)
+                       count += (csrs[k].offsets != nullptr) ? 1 : 0 ;
+                     return count ;
+                   }
+
+  public  :
+                   FrozenGraph() : _ids( nullptr ), _size( 0 ), _pool_offsets( nullptr ), _pool_chars( nullptr ), _pool_size( 0 ) {}
+                   FrozenGraph( const EntityMgr &mgr ) : _ids( nullptr ), _size( 0 ), _pool_offsets( nullptr ), _pool_chars( nullptr ), _pool_size( 0 )
+                   {
+                     freeze( mgr ) ;
+                   }
+
+    void           freeze( const EntityMgr &mgr )
+                   {
+                     std::unordered_map<Entity*, uint32_t>      index ;
+                     std::unordered_map<uint32_t, uint32_t>     pool ;   // MetaValue id -> pool index
+                     std::vector<Entity*>                       entities ;
+
+                     reset() ;
+
+                     entities.reserve( mgr.size() ) ;
+                     for (EntityMap_iter it = mgr.begin(); it != mgr.end(); it++)
+                       entities.push_back( &(*it) ) ;
+                     std::sort( entities.begin(), entities.end(), EntityIdLess() ) ;
+
+                     std::vector<uint32_t>  &ids = _owned.ids ;
+                     ids.reserve( entities.size() ) ;
+                     index.reserve( entities.size() ) ;
+                     for (size_t i = 0; i < entities.size(); i++)
+                     {
+                       index[entities[i]] = (uint32_t)i ;
+                       ids.push_back( entities[i]->id() ) ;
+                     }
+
+                     uint32_t  n      = (uint32_t)entities.size() ;
+                     uint32_t  n_rel  = RelationType::table().size() ;
+                     uint32_t  n_meta = MetaKey::table().size() ;
+
+                     // relation types first, then meta keys, in one set of vectors
+                     std::vector< std::vector<uint32_t> >  &offsets = _owned.offsets ;
+                     std::vector< std::vector<uint32_t> >  &targets = _owned.targets ;
+                     offsets.resize( n_rel + n_meta ) ;
+                     targets.resize( n_rel + n_meta ) ;
+
+                     // first pass: per-row counts into offsets[i + 1]
+                     for (uint32_t i = 0; i < n; i++)
+                     {
+                       RelationMap  &links = entities[i]->relations() ;
+                       for (RelationMap_iter it = links.begin(); it != links.end(); it++)
+                       {
+                         std::vector<uint32_t>  &off = offsets[(*it).first.id()] ;
+                         if (off.empty())
+                           off.assign( n + 1, 0 ) ;
+                         off[i + 1] = (uint32_t)(*it).second.size() ;
+                       }
+
+                       const MetaSet  &meta = entities[i]->meta_data() ;
+                       for (const MetaPair *p = meta.begin(); p != meta.end(); p++)
+                       {
+                         std::vector<uint32_t>  &off = offsets[n_rel + (*p).key.id()] ;
+                         if (off.empty())
+                           off.assign( n + 1, 0 ) ;
+                         off[i + 1]++ ;
+                       }
+                     }
+
+                     for (size_t k = 0; k < offsets.size(); k++)
+                     {
+                       std::vector<uint32_t>  &off = offsets[k] ;
+                       if (off.empty())
+                         continue ;
+                       for (uint32_t i = 0; i < n; i++)
+                         off[i + 1] += off[i] ;
+                       targets[k].resize( off[n] ) ;
+                     }
+
+                     // second pass: fill rows, interning meta values into the pool
+                     _owned.pool_offsets.push_back( 0 ) ;
+                     for (uint32_t i = 0; i < n; i++)
+                     {
+                       RelationMap  &links = entities[i]->relations() ;
+                       for (RelationMap_iter it = links.begin(); it != links.end(); it++)
+                       {
+                         uint32_t   k   = (*it).first.id() ;
+                         uint32_t  *row = targets[k].data() + offsets[k][i] ;
+                         uint32_t   j   = 0 ;
+                         for (EntityVec_iter eit = (*it).second.begin(); eit != (*it).second.end(); eit++)
+                           row[j++] = index[(*eit)] ;
+                         std::sort( row, row + j ) ;
+                       }
+
+                       // pairs are grouped by key, values in the order they were added
+                       const MetaSet  &meta = entities[i]->meta_data() ;
+                       uint32_t       *row  = nullptr ;
+                       for (const MetaPair *p = meta.begin(); p != meta.end(); p++)
+                       {
+                         uint32_t  k = n_rel + (*p).key.id() ;
+                         if (p == meta.begin() || (*p).key != p[-1].key)
+                           row = targets[k].data() + offsets[k][i] ;
+
+                         std::pair<std::unordered_map<uint32_t, uint32_t>::iterator, bool>  r =
+                           pool.insert( std::make_pair( (*p).value.id(), (uint32_t)pool.size() )) ;
+                         if (r.second)
+                         {
+                           _owned.pool_chars.append( (*p).value.str() ) ;
+                           _owned.pool_offsets.push_back( _owned.pool_chars.size() ) ;
+                         }
+                         *row++ = (*r.first).second ;
+                       }
+                     }
+
+                     _ids  = ids.data() ;
+                     _size = n ;
+                     _relations.resize( n_rel ) ;
+                     _meta.resize( n_meta ) ;
+                     for (size_t k = 0; k < offsets.size(); k++)
+                     {
+                       if (offsets[k].empty())
+                         continue ;
+                       Csr  &csr = (k < n_rel) ? _relations[k] : _meta[k - n_rel] ;
+                       csr.offsets = offsets[k].data() ;
+                       csr.targets = targets[k].data() ;
+                     }
+                     _pool_offsets = _owned.pool_offsets.data() ;
+                     _pool_chars   = _owned.pool_chars.data() ;
+                     _pool_size    = (uint32_t)pool.size() ;
+                   }
+
+    // writes the graph as a little-endian snapshot:
+    //
+    //   header   magic "BRELSNP\0", u32 version, u32 byte-order mark,
+    //            u32 entities, u32 relation types, u32 meta keys, u32 values
+    //   array    u32 ids[entities]
+    //   array    u64 pool offsets[values + 1],  array char pool
+    //   per relation type:  array char name, array u32 offsets[entities + 1], array u32 targets
+    //   per meta key:       array char name, array u32 offsets[entities + 1], array u32 value ids
+    //
+    // every array is a u64 byte count then the payload, padded to 8 bytes.
+    // relation types and meta keys are stored by name, so the file does not
+    // depend on the interning order of the process that wrote it
+    bool           save( const std::string &path ) const
+                   {
+                     FILE  *f = fopen( path.c_str(), "wb" ) ;
+                     if (f == nullptr)
+                       return false ;
+
+                     BinaryWriter  out( f ) ;
+                     out.bytes( magic(), 8 ) ;
+                     out.u32( version ) ;
+                     out.u32( 0x01020304 ) ;
+                     out.u32( _size ) ;
+                     out.u32( used( _relations )) ;
+                     out.u32( used( _meta )) ;
+                     out.u32( _pool_size ) ;
+
+                     out.array( _ids, _size ) ;
+                     out.array( _pool_offsets, _pool_size + 1 ) ;
+                     out.chars( _pool_chars, _pool_size ? (size_t)_pool_offsets[_pool_size] : 0 ) ;
+                     write_csrs<RelationType>( out, _relations, _size ) ;
+                     write_csrs<MetaKey>( out, _meta, _size ) ;
+
+                     bool  ok = out.ok() ;
+                     return (fclose( f ) == 0) && ok ;
+                   }
+
+    // maps a snapshot written by save().  arrays are used in place, so
+    // opening costs a handful of page faults rather than a rebuild.  the
+    // section sizes are checked; row contents are trusted (see verify()).
+    // only little-endian hosts can use the image directly
+    bool           open( const std::string &path )
+                   {
+                     reset() ;
+                     if (!host_is_little_endian() || !_file.open( path ))
+                       return false ;
+
+                     BinaryReader    in( _file.data(), _file.size() ) ;
+                     const uint8_t  *head = in.bytes( 8 ) ;
+                     if (head == nullptr || memcmp( head, magic(), 8 ) != 0 ||
+                         in.u32() != version || in.u32() != 0x01020304)
+                     {
+                       reset() ;
+                       return false ;
+                     }
+
+                     uint32_t  n      = in.u32() ;
+                     uint32_t  n_rel  = in.u32() ;
+                     uint32_t  n_meta = in.u32() ;
+                     uint32_t  n_pool = in.u32() ;
+
+                     size_t  count ;
+                     size_t  pool_count ;
+                     size_t  char_count ;
+                     _ids          = in.array<uint32_t>( count ) ;
+                     _size         = n ;
+                     _pool_offsets = in.array<uint64_t>( pool_count ) ;
+                     _pool_chars   = in.array<char>( char_count ) ;
+                     _pool_size    = n_pool ;
+                     if (!in.ok() || count != n || pool_count != (size_t)n_pool + 1 || _pool_offsets[n_pool] != char_count)
+                     {
+                       reset() ;
+                       return false ;
+                     }
+
+                     std::string  name ;
+                     for (uint32_t k = 0; k < n_rel + n_meta; k++)
+                     {
+                       Csr  csr ;
+                       if (!read_csr( in, name, csr ))
+                       {
+                         reset() ;
+                         return false ;
+                       }
+                       std::vector<Csr>  &csrs = (k < n_rel) ? _relations : _meta ;
+                       uint32_t           id   = (k < n_rel) ? RelationType( name ).id() : MetaKey( name ).id() ;
+                       if (csrs.size() <= id)
+                         csrs.resize( id + 1 ) ;
+                       csrs[id] = csr ;
+                     }
+                     return true ;
+                   }
+
+    // full scan of an opened image: ascending ids, monotonic offsets, every
+    // target and value id in range.  touches every page, so it is opt-in
+    bool           verify() const
+                   {
+                     for (uint32_t i = 1; i < _size; i++)
+                     {
+                       if (_ids[i - 1] >= _ids[i])
+                         return false ;
+                     }
+                     for (uint32_t v = 0; v < _pool_size; v++)
+                     {
+                       if (_pool_offsets[v] > _pool_offsets[v + 1])
+                         return false ;
+                     }
+                     for (size_t k = 0; k < _relations.size() + _meta.size(); k++)
+                     {
+                       const Csr  &csr   = (k < _relations.size()) ? _relations[k] : _meta[k - _relations.size()] ;
+                       uint32_t    limit = (k < _relations.size()) ? _size : _pool_size ;
+                       if (csr.offsets == nullptr)
+                         continue ;
+                       for (uint32_t i = 0; i < _size; i++)
+                       {
+                         if (csr.offsets[i] > csr.offsets[i + 1])
+                           return false ;
+                       }
+                       for (uint32_t t = 0; t < csr.offsets[_size]; t++)
+                       {
+                         if (csr.targets[t] >= limit)
+                           return false ;
+                       }
+                     }
+                     return true ;
+                   }
+
+    // rebuilds a mutable population from the graph (e.g. after open())
+    void           thaw( EntityMgr &mgr ) const
+                   {
+                     for (uint32_t i = 0; i < _size; i++)
+                       mgr.get( _ids[i] ) ;
+
+                     for (uint32_t i = 0; i < _size; i++)
+                     {
+                       Entity  &e = mgr.get( _ids[i] ) ;
+                       for (size_t m = 0; m < _meta.size(); m++)
+                       {
+                         IndexSpan  values = get_meta( i, MetaKey( (uint32_t)m )) ;
+                         for (size_t v = 0; v < values.size(); v++)
+                           e.meta( MetaKey( (uint32_t)m ), value( values[v] ).str() ) ;
+                       }
+                       for (size_t r = 0; r < _relations.size(); r++)
+                       {
+                         IndexSpan  row = relation( i, RelationType( (uint32_t)r )) ;
+                         for (size_t t = 0; t < row.size(); t++)
+                           e.link( RelationType( (uint32_t)r ), mgr.get( _ids[row[t]] )) ;
+                       }
+                     }
+                   }
+
+    uint32_t       size() const { return _size ; }
+    uint32_t       id( uint32_t index_ ) const { return _ids[index_] ; }
+    uint32_t       index( uint32_t id_ ) const
+                   {
+                     const uint32_t  *it = std::lower_bound( _ids, _ids + _size, id_ ) ;
+                     return (it == _ids + _size || (*it) != id_) ? npos : (uint32_t)(it - _ids) ;
+                   }
+
+    IndexSpan      relation( uint32_t index_, RelationType type_ ) const
+                   {
+                     if (!type_.valid() || type_.id() >= _relations.size())
+                       return IndexSpan() ;
+                     const Csr  &csr = _relations[type_.id()] ;
+                     if (csr.offsets == nullptr)
+                       return IndexSpan() ;
+                     return IndexSpan( csr.targets + csr.offsets[index_], csr.targets + csr.offsets[index_ + 1] ) ;
+                   }
+    IndexSpan      relation( uint32_t index_, const std::string &type_ ) const
+                   {
+                     return relation( index_, RelationType::find( type_ )) ;
+                   }
+    bool           is_linked( uint32_t index_, RelationType type_, uint32_t other ) const
+                   {
+                     IndexSpan  row = relation( index_, type_ ) ;
+                     return std::binary_search( row.begin(), row.end(), other ) ;
+                   }
+    bool           is_linked( uint32_t index_, const std::string &type_, uint32_t other ) const
+                   {
+                     return is_linked( index_, RelationType::find( type_ ), other ) ;
+                   }
+
+    // value ids for 'key' on one entity; resolve with value().  equal
+    // strings share an id, so ids can be compared directly
+    IndexSpan      get_meta( uint32_t index_, MetaKey key ) const
+                   {
+                     if (!key.valid() || key.id() >= _meta.size())
+                       return IndexSpan() ;
+                     const Csr  &col = _meta[key.id()] ;
+                     if (col.offsets == nullptr)
+                       return IndexSpan() ;
+                     return IndexSpan( col.targets + col.offsets[index_], col.targets + col.offsets[index_ + 1] ) ;
+                   }
+    IndexSpan      get_meta( uint32_t index_, const std::string &key ) const
+                   {
+                     return get_meta( index_, MetaKey::find( key )) ;
+                   }
+    uint32_t       values() const { return _pool_size ; }
+    StringRef      value( uint32_t value_id ) const
+                   {
+                     return StringRef( _pool_chars + _pool_offsets[value_id], (size_t)(_pool_offsets[value_id + 1] - _pool_offsets[value_id]) ) ;
+                   }
+
+    // breadth-first walk from 'root', see traverse().  'out' and 'scratch'
+    // are caller-owned and reused across calls
+    void           find_relations( uint32_t root, FrozenRelationVec &out, FrozenScratch &scratch,
+                                   uint32_t max_depth = PackedPath::max_steps ) const
+                   {
+                     find_relations( root, TraversalSpec::family(), out, scratch, max_depth ) ;
+                   }
+    void           find_relations( uint32_t root, const TraversalSpec &spec, FrozenRelationVec &out, FrozenScratch &scratch,
+                                   uint32_t max_depth = PackedPath::max_steps ) const
+                   {
+                     out.clear() ;
+                     traverse( *this, root, spec, scratch, max_depth, [&out]( uint32_t index_, PackedPath path ) -> Visit
+                               {
+                                 out.push_back( FrozenRelation( index_, path )) ;
+                                 return Visit::expand ;
+                               }) ;
+                   }
+} ; // class FrozenGraph
+
+inline void GraphTraits<FrozenGraph>::expand( const FrozenGraph &g, uint32_t index_, const TraversalSpec &spec, IndexSpan *out )
+{
+  for (uint8_t code = 0; code < spec.size(); code++)
+    out[code] = g.relation( index_, spec.type( code )) ;
+} // GraphTraits<FrozenGraph> :: expand
+
+inline void GraphTraits<FrozenGraph>::prepare( const FrozenGraph &g, visited_type &visited )
+{
+  visited.resize( g.size() ) ;
+} // GraphTraits<FrozenGraph> :: prepare
+
+}} ; // namespace
+
+#endif
@@ -0,0 +1,209 @@
+/*!
+  @file       journal.hpp
+  @brief      Snapshot plus change log persistence for an EntityMgr, with compaction
+
+  @author     Robert McInnis
+  @date       september 21, 2016
+  @par        copyright (c) 2016 Solid ICE Technologies, Inc.  All rights reserved.
+
+  Distributed under the Boost Software License, Version 1.0. (See accompanying
+  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+*/
+#ifndef JOURNAL_HPP
+#define JOURNAL_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <boost/relations/change_log.hpp>
+#include <boost/relations/entity.hpp>
+#include <boost/relations/frozen_graph.hpp>
+#include <boost/relations/mapped_file.hpp>
+
+namespace boost { namespace relations {
+
+// func:   file_fingerprint
+// desc:   64-bit FNV-1a over the file, a word at a time, and its size; never
+//         0, which stands for "no file"
+//
+inline uint64_t file_fingerprint( const std::string &path )
+{
+  MappedFile  file ;
+  if (!file.open( path ))
+    return 0 ;
+
+  const uint8_t  *p = file.data() ;
+  size_t          n = file.size() ;
+  uint64_t        h = 14695981039346656037ull ^ n ;
+  uint64_t        w ;
+  size_t          i = 0 ;
+
+  for (; i + 8 <= n; i += 8)
+  {
+    memcpy( &w, p + i, 8 ) ;
+    h = (h ^ w) * 1099511628211ull ;
+  }
+  for (; i < n; i++)
+    h = (h ^ p[i]) * 1099511628211ull ;
+  return h ? h : 1 ;
+} // :: file_fingerprint
+
+// func:   sync_path
+// desc:   flush a closed file, or a directory's entries, to disk
+//
+inline bool sync_path( const std::string &path )
+{
+#ifdef BOOST_RELATIONS_HAS_MMAP
+  int  fd = ::open( path.c_str(), O_RDONLY ) ;
+  if (fd < 0)
+    return false ;
+  bool  ok = fsync( fd ) == 0 ;
+  ::close( fd ) ;
+  return ok ;
+#else
+  (void)path ;
+  return true ;
+#endif
+} // :: sync_path
+
+// class:  Journal
+// desc:   a population kept as a snapshot (FrozenGraph::save) at
+//         '<path>.snap' plus the change log of the edits made since at
+//         '<path>.log'.  open() rebuilds the population from the two and logs
+//         to it from then on; commit() makes the edits so far durable;
+//         compact() folds the log into a new snapshot.  the log header holds
+//         the fingerprint of the snapshot it follows, so a crash between
+//         installing a new snapshot and its empty log leaves the old log
+//         ignored, never replayed twice.  compact() and close() must not run
+//         while other threads edit the population
+//
+class Journal
+{
+  private :
+    std::string    _path ;
+    ChangeLog      _log ;
+    EntityMgr     *_mgr ;
+    LogInfo        _recovered ;
+
+                   Journal( const Journal & ) ;
+    Journal       &operator= ( const Journal & ) ;
+
+    static bool    exists( const std::string &path )
+                   {
+                     FILE  *f = fopen( path.c_str(), "rb" ) ;
+                     if (f != nullptr)
+                       fclose( f ) ;
+                     return f != nullptr ;
+                   }
+    std::string    directory() const
+                   {
+                     size_t  slash = _path.rfind( '/' ) ;
+                     return (slash == std::string::npos) ? "." : _path.substr( 0, slash + 1 ) ;
+                   }
+
+  public  :
+    explicit       Journal( const std::string &path, size_t group_bytes = ChangeLog::default_group_bytes, bool sync = true )
+                   : _path( path ), _log( group_bytes, sync ), _mgr( nullptr ) {}
+                  ~Journal() { close() ; }
+
+    std::string    snapshot_path() const { return _path + ".snap" ; }
+    std::string    log_path() const { return _path + ".log" ; }
+
+    // fills 'mgr', which should be empty, from the snapshot and the log, then
+    // attaches the log to it.  missing files count as empty.  false if a file
+    // can't be read, or if there is a log but its snapshot is gone
+    bool           open( EntityMgr &mgr )
+                   {
+                     close() ;
+                     _recovered = LogInfo() ;
+
+                     std::string  snap = snapshot_path() ;
+                     std::string  log  = log_path() ;
+                     uint64_t     base = 0 ;
+                     if (exists( snap ))
+                     {
+                       FrozenGraph  graph ;
+                       if (!graph.open( snap ))
+                         return false ;
+                       graph.thaw( mgr ) ;
+                       base = file_fingerprint( snap ) ;
+                     }
+
+                     // a log on another base is one the snapshot already holds
+                     uint64_t  log_base = 0 ;
+                     bool      has_log  = ChangeLog::read_base( log, log_base ) ;
+                     if (has_log && log_base == base)
+                     {
+                       if (!ChangeLog::replay( log, mgr, _recovered ) || !_log.open( log, _recovered ))
+                         return false ;
+                     }
+                     else if (has_log && base == 0)
+                       return false ;
+                     else if (!_log.create( log, base ))
+                       return false ;
+
+                     mgr.change_log( &_log ) ;
+                     _mgr = &mgr ;
+                     return true ;
+                   }
+
+    // stops logging; pending edits are committed first
+    void           close()
+                   {
+                     if (_mgr != nullptr)
+                       (*_mgr).change_log( nullptr ) ;
+                     _mgr = nullptr ;
+                     _log.close() ;
+                   }
+
+    bool           commit() { return _log.commit() ; }
+
+    // writes the population as a new snapshot and starts an empty log on it
+    bool           compact()
+                   {
+                     if (_mgr == nullptr || !_log.commit())
+                       return false ;
+
+                     std::string  snap     = snapshot_path() ;
+                     std::string  log      = log_path() ;
+                     std::string  snap_tmp = snap + ".tmp" ;
+                     std::string  log_tmp  = log + ".tmp" ;
+                     uint64_t     old_base = _log.base() ;
+
+                     if (!FrozenGraph( *_mgr ).save( snap_tmp ) || !sync_path( snap_tmp ))
+                       return false ;
+                     uint64_t  base = file_fingerprint( snap_tmp ) ;
+
+                     // the new snapshot goes in first; until the log follows,
+                     // open() ignores the old log as already folded in
+                     _log.close() ;
+                     if (!_log.create( log_tmp, base ) || std::rename( snap_tmp.c_str(), snap.c_str() ) != 0)
+                     {
+                       _log.close() ;
+                       std::remove( log_tmp.c_str() ) ;
+                       _log.open( log, old_base ) ;
+                       return false ;
+                     }
+                     if (std::rename( log_tmp.c_str(), log.c_str() ) != 0)
+                     {
+                       _log.close() ;
+                       return _log.create( log, base ) ;
+                     }
+                     return sync_path( directory() ) ;
+                   }
+    // compact() once the log has grown to 'log_bytes'; call it periodically
+    bool           compact( uint64_t log_bytes )
+                   {
+                     return (_log.size() < log_bytes) || compact() ;
+                   }
+
+    ChangeLog     &log() { return _log ; }
+    // what open() replayed
+    const LogInfo &recovered() const { return _recovered ; }
+} ; // class Journal
+
+}} ; // namespace
+
+#endif
@@ -0,0 +1,339 @@
+/*!
+  @file       loader.hpp
+  @brief      Streaming bulk loader for entities, meta and edges from delimited text
+
+  @author     Robert McInnis
+  @date       september 21, 2016
+  @par        copyright (c) 2016 Solid ICE Technologies, Inc.  All rights reserved.
+
+  Distributed under the Boost Software License, Version 1.0. (See accompanying
+  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+*/
+#ifndef LOADER_HPP
+#define LOADER_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/relations/entity.hpp>
+#include <boost/relations/reciprocal.hpp>
+#include <boost/relations/string_ref.hpp>
+#include <boost/relations/thread_pool.hpp>
+
+namespace boost { namespace relations {
+
+typedef std::vector<StringRef>            FieldVec ;
+typedef std::vector<StringRef>::iterator  FieldVec_iter ;
+
+// class:  DelimitedReader
+// desc:   reads a delimited text file in fixed-size chunks and hands out one
+//         row at a time as fields pointing into the chunk buffer.  only the
+//         buffer is held, so memory stays bounded by the longest line no
+//         matter how large the file is.  fields wrapped in double quotes may
+//         contain the delimiter; the quotes are stripped but doubled quotes
+//         inside are left as they are (no copy is made to unescape them)
+//
+class DelimitedReader
+{
+  private :
+    FILE                *_file ;
+    std::vector<char>    _buf ;
+    size_t               _begin ;    // start of the unread part of _buf
+    size_t               _end ;      // end of valid data in _buf
+    bool                 _eof ;
+    bool                 _failed ;   // a read error ended the input
+    char                 _delim ;
+    uint64_t             _bytes ;
+
+                   DelimitedReader( const DelimitedReader & ) ;
+    DelimitedReader &operator= ( const DelimitedReader & ) ;
+
+    // moves the partial line to the front and refills the rest; doubles the
+    // buffer when a single line does not fit
+    bool           fill()
+                   {
+                     if (_eof)
+                       return false ;
+                     if (_begin > 0)
+                     {
+                       memmove( _buf.data(), _buf.data() + _begin, _end - _begin ) ;
+                       _end  -= _begin ;
+                       _begin = 0 ;
+                     }
+                     if (_end == _buf.size())
+                       _buf.resize( _buf.size() * 2 ) ;
+
+                     size_t  n = fread( _buf.data() + _end, 1, _buf.size() - _end, _file ) ;
+                     _end   += n ;
+                     _bytes += n ;
+                     if (n == 0)
+                     {
+                       _eof    = true ;
+                       _failed = ferror( _file ) != 0 ;
+                     }
+                     return n != 0 ;
+                   }
+
+    void           split( const char *p, const char *end, FieldVec &fields ) const
+                   {
+                     fields.clear() ;
+                     for (;;)
+                     {
+                       const char  *first = p ;
+                       const char  *last ;
+                       if (p != end && *p == '"')
+                       {
+                         const char  *q = ++first ;
+                         while (q != end && !(*q == '"' && (q + 1 == end || q[1] == _delim)))
+                           q += (*q == '"' && q + 1 != end && q[1] == '"') ? 2 : 1 ;
+                         last = q ;
+                         p    = (q == end) ? end : q + 1 ;
+                       }
+                       else
+                       {
+                         p    = (const char*)memchr( p, _delim, (size_t)(end - p) ) ;
+                         p    = (p == nullptr) ? end : p ;
+                         last = p ;
+                       }
+                       fields.push_back( StringRef( first, (size_t)(last - first) )) ;
+                       if (p == end)
+                         return ;
+                       p++ ;  // delimiter
+                     }
+                   }
+
+  public  :
+    static const size_t  default_chunk = 1 << 20 ;
+
+                   DelimitedReader( char delim_ = ',', size_t chunk = default_chunk )
+                     : _file( nullptr ), _buf( chunk ? chunk : default_chunk ), _begin( 0 ), _end( 0 ), _eof( false ), _failed( false ), _delim( delim_ ), _bytes( 0 ) {}
+                  ~DelimitedReader() { close() ; }
+
+    bool           open( const std::string &path )
+                   {
+                     close() ;
+                     _file = fopen( path.c_str(), "rb" ) ;
+                     return _file != nullptr ;
+                   }
+    void           close()
+                   {
+                     if (_file != nullptr)
+                       fclose( _file ) ;
+                     _file  = nullptr ;
+                     _begin  = _end = 0 ;
+                     _eof    = false ;
+                     _failed = false ;
+                     _bytes  = 0 ;
+                   }
+
+    char           delimiter() const { return _delim ; }
+    uint64_t       bytes() const { return _bytes ; }
+    // next() stopped at a read error rather than the end of the file
+    bool           failed() const { return _failed ; }
+
+    // next non-empty row; fields stay valid until the following call.
+    // returns false at end of file or on a read error
+    bool           next( FieldVec &fields )
+                   {
+                     if (_file == nullptr)
+                       return false ;
+                     for (;;)
+                     {
+                       const char  *base = _buf.data() ;
+                       const char  *nl   = (const char*)memchr( base + _begin, '\n', _end - _begin ) ;
+                       if (nl == nullptr && fill())
+                         continue ;
+                       if (nl == nullptr && _begin == _end)
+                         return false ;
+
+                       base = _buf.data() ;
+                       const char  *first = base + _begin ;
+                       const char  *last  = (nl != nullptr) ? nl : base + _end ;
+                       _begin = (nl != nullptr) ? (size_t)(nl - base) + 1 : _end ;
+                       if (last != first && last[-1] == '\r')
+                         last-- ;
+                       if (last == first)
+                         continue ;
+                       split( first, last, fields ) ;
+                       return true ;
+                     }
+                   }
+} ; // class DelimitedReader
+
+// struct: LoadStats
+// desc:   counters for one load_* call
+//
+struct LoadStats
+{
+  uint64_t         rows ;       // rows applied
+  uint64_t         bad_rows ;   // rows skipped: too few fields or a bad id
+  uint64_t         bytes ;
+  double           seconds ;
+
+                   LoadStats() : rows( 0 ), bad_rows( 0 ), bytes( 0 ), seconds( 0 ) {}
+
+  double           rows_per_sec() const { return (seconds > 0) ? rows / seconds : 0 ; }
+} ; // struct LoadStats
+
+// class:  BulkLoader
+// desc:   feeds an EntityMgr from delimited files.
+//
+//           edges:  from_id <d> relation <d> to_id       ('from' is-the 'relation' of 'to')
+//           meta:   id <d> key <d> value [<d> value ...]
+//
+//         edges are gathered into batches and handed to the ReciprocalMgr
+//         (or linked directly when there is none), on a ThreadPool if one is
+//         set.  conditional reciprocal rules look at meta, so load meta
+//         before edges.  relation names and meta keys are resolved through a
+//         hash cache probed in place, so a row costs no allocation beyond
+//         the meta values themselves
+//
+class BulkLoader
+{
+  private :
+    typedef std::unordered_map< StringRef, uint32_t, StringRefHash >                  NameIdMap ;
+    typedef std::unordered_map< StringRef, uint32_t, StringRefHash >::const_iterator  NameIdMap_iter ;
+
+    // name -> symbol id; keys point into 'names', whose strings never move
+    struct NameCache
+    {
+      NameIdMap                ids ;
+      std::deque<std::string>  names ;
+    } ;
+
+    EntityMgr       &_mgr ;
+    ReciprocalMgr   *_recip ;
+    ThreadPool      *_pool ;
+    char             _delim ;
+    size_t           _batch ;
+    bool             _header ;
+    NameCache        _relation_names ;
+    NameCache        _meta_names ;
+
+    template <typename Sym>
+    static Sym     resolve( NameCache &cache, StringRef name )
+                   {
+                     NameIdMap_iter  it = cache.ids.find( name ) ;
+                     if (it != cache.ids.end())
+                       return Sym( (*it).second ) ;
+                     cache.names.push_back( name.str() ) ;
+                     Sym  s( cache.names.back() ) ;
+                     cache.ids.insert( std::make_pair( StringRef( cache.names.back() ), s.id() )) ;
+                     return s ;
+                   }
+    static bool    parse_id( StringRef s, uint32_t &id )
+                   {
+                     uint64_t  v = 0 ;
+                     if (s.empty() || s.size > 10)
+                       return false ;
+                     for (size_t i = 0; i < s.size; i++)
+                     {
+                       if (s[i] < '0' || s[i] > '9')
+                         return false ;
+                       v = v * 10 + (uint64_t)(s[i] - '0') ;
+                     }
+                     id = (uint32_t)v ;
+                     return v <= 0xffffffffull ;
+                   }
+    void           flush( EdgeVec &edges )
+                   {
+                     if (edges.empty())
+                       return ;
+                     if (_recip != nullptr && _pool != nullptr)
+                       _recip->link_with_reciprocals( _mgr, edges, *_pool ) ;
+                     else if (_recip != nullptr)
+                       _recip->link_with_reciprocals( _mgr, edges ) ;
+                     else
+                     {
+                       for (EdgeVec_iter it = edges.begin(); it != edges.end(); it++)
+                         _mgr.get( (*it).from ).link( (*it).type, _mgr.get( (*it).to )) ;
+                     }
+                     edges.clear() ;
+                   }
+
+    // rows through 'row', which returns false for a bad row, then 'finish'
+    // for work the rows left pending; both fall in the timed window.  false
+    // if the file can't be opened or a read fails
+    template <typename RowFn, typename FinishFn>
+    bool           load( const std::string &path, LoadStats &stats, RowFn row, FinishFn finish )
+                   {
+                     std::chrono::steady_clock::time_point  start = std::chrono::steady_clock::now() ;
+                     DelimitedReader                        in( _delim ) ;
+                     FieldVec                               fields ;
+
+                     stats = LoadStats() ;
+                     if (!in.open( path ))
+                       return false ;
+                     if (_header)
+                       in.next( fields ) ;
+                     while (in.next( fields ))
+                     {
+                       if (row( fields ))
+                         stats.rows++ ;
+                       else
+                         stats.bad_rows++ ;
+                     }
+                     finish() ;
+                     stats.bytes   = in.bytes() ;
+                     stats.seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count() ;
+                     return !in.failed() ;
+                   }
+
+  public  :
+    static const size_t  default_batch = 64 * 1024 ;
+
+                   BulkLoader( EntityMgr &mgr_, ReciprocalMgr *recip_ = nullptr, char delim_ = ',' )
+                     : _mgr( mgr_ ), _recip( recip_ ), _pool( nullptr ), _delim( delim_ ), _batch( default_batch ), _header( false ) {}
+
+    void           delimiter( char d ) { _delim = d ; }
+    void           batch_size( size_t n ) { _batch = n ? n : 1 ; }
+    void           skip_header( bool on ) { _header = on ; }
+    void           pool( ThreadPool *p ) { _pool = p ; }
+
+    // false if the file can't be opened or read to its end; the rows read
+    // before a read error are applied and counted
+    bool           load_edges( const std::string &path, LoadStats &stats )
+                   {
+                     EdgeVec  edges ;
+                     edges.reserve( _batch ) ;
+
+                     return load( path, stats, [&]( FieldVec &f ) -> bool
+                                      {
+                                        uint32_t  from ;
+                                        uint32_t  to ;
+                                        if (f.size() < 3 || !parse_id( f[0], from ) || !parse_id( f[2], to ) || f[1].empty())
+                                          return false ;
+                                        edges.push_back( Edge( from, resolve<RelationType>( _relation_names, f[1] ), to )) ;
+                                        if (edges.size() >= _batch)
+                                          flush( edges ) ;
+                                        return true ;
+                                      },
+                                      [&]() { flush( edges ) ; }) ;
+                   }
+    bool           load_meta( const std::string &path, LoadStats &stats )
+                   {
+                     return load( path, stats, [&]( FieldVec &f ) -> bool
+                                  {
+                                    uint32_t  id ;
+                                    if (f.size() < 3 || !parse_id( f[0], id ) || f[1].empty())
+                                      return false ;
+                                    Entity   &e   = _mgr.get( id ) ;
+                                    MetaKey   key = resolve<MetaKey>( _meta_names, f[1] ) ;
+                                    for (size_t i = 2; i < f.size(); i++)
+                                      e.meta( key, f[i].str() ) ;
+                                    return true ;
+                                  },
+                                  []() {}) ;
+                   }
+} ; // class BulkLoader
+
+}} ; // namespace
+
+#endif
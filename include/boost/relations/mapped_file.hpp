@@ -0,0 +1,245 @@
+/*!
+  @file       mapped_file.hpp
+  @brief      Read-only file mapping and little-endian binary writer
+
+  @author     Robert McInnis
+  @date       september 21, 2016
+  @par        copyright (c) 2016 Solid ICE Technologies, Inc.  All rights reserved.
+
+  Distributed under the Boost Software License, Version 1.0. (See accompanying
+  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+*/
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define BOOST_RELATIONS_HAS_MMAP 1
+#endif
+
+namespace boost { namespace relations {
+
+// func:   host_is_little_endian
+//
+inline bool host_is_little_endian()
+{
+  const uint16_t  probe = 1 ;
+  return *(const uint8_t*)&probe == 1 ;
+} // :: host_is_little_endian
+
+// class:  MappedFile
+// desc:   whole file mapped read-only.  where mmap isn't available the file
+//         is read into memory instead, so callers see the same interface
+//
+class MappedFile
+{
+  private :
+    const uint8_t         *_data ;
+    size_t                 _size ;
+    std::vector<uint8_t>   _copy ;    // fallback storage
+
+                   MappedFile( const MappedFile & ) ;
+    MappedFile    &operator= ( const MappedFile & ) ;
+
+  public  :
+                   MappedFile() : _data( nullptr ), _size( 0 ) {}
+                  ~MappedFile() { close() ; }
+
+    bool           open( const std::string &path )
+                   {
+                     close() ;
+#ifdef BOOST_RELATIONS_HAS_MMAP
+                     int  fd = ::open( path.c_str(), O_RDONLY ) ;
+                     if (fd < 0)
+                       return false ;
+
+                     struct stat  st ;
+                     if (fstat( fd, &st ) != 0 || st.st_size == 0)
+                     {
+                       ::close( fd ) ;
+                       return false ;
+                     }
+
+                     void  *p = mmap( nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0 ) ;
+                     ::close( fd ) ;
+                     if (p == MAP_FAILED)
+                       return false ;
+
+                     _data = (const uint8_t*)p ;
+                     _size = (size_t)st.st_size ;
+                     return true ;
+#else
+                     FILE  *f = fopen( path.c_str(), "rb" ) ;
+                     if (f == nullptr)
+                       return false ;
+                     fseek( f, 0, SEEK_END ) ;
+                     long  n = ftell( f ) ;
+                     fseek( f, 0, SEEK_SET ) ;
+                     _copy.resize( n > 0 ? (size_t)n : 0 ) ;
+                     bool  ok = n > 0 && fread( _copy.data(), 1, _copy.size(), f ) == _copy.size() ;
+                     fclose( f ) ;
+                     if (!ok)
+                     {
+                       _copy.clear() ;
+                       return false ;
+                     }
+                     _data = _copy.data() ;
+                     _size = _copy.size() ;
+                     return true ;
+#endif
+                   }
+    void           close()
+                   {
+#ifdef BOOST_RELATIONS_HAS_MMAP
+                     if (_data != nullptr)
+                       munmap( (void*)_data, _size ) ;
+#endif
+                     _copy.clear() ;
+                     _data = nullptr ;
+                     _size = 0 ;
+                   }
+
+    bool           is_open() const { return _data != nullptr ; }
+    const uint8_t *data() const { return _data ; }
+    size_t         size() const { return _size ; }
+} ; // class MappedFile
+
+// class:  BinaryWriter
+// desc:   buffered little-endian writer.  arrays are written as a u64 byte
+//         count followed by the payload, padded to 8 bytes so every array in
+//         a mapped file is naturally aligned
+//
+class BinaryWriter
+{
+  private :
+    FILE          *_file ;
+    uint64_t       _pos ;
+    bool           _ok ;
+
+                   BinaryWriter( const BinaryWriter & ) ;
+    BinaryWriter  &operator= ( const BinaryWriter & ) ;
+
+    void           raw( const void *p, size_t n )
+                   {
+                     if (_ok && n != 0 && fwrite( p, 1, n, _file ) != n)
+                       _ok = false ;
+                     _pos += n ;
+                   }
+    template <typename T>
+    void           swapped( const T *p, size_t count )
+                   {
+                     if (host_is_little_endian())
+                     {
+                       raw( p, count * sizeof(T) ) ;
+                       return ;
+                     }
+                     for (size_t i = 0; i < count; i++)
+                     {
+                       uint8_t  b[sizeof(T)] ;
+                       for (size_t k = 0; k < sizeof(T); k++)
+                         b[k] = (uint8_t)((uint64_t)p[i] >> (8 * k)) ;
+                       raw( b, sizeof(T) ) ;
+                     }
+                   }
+
+  public  :
+                   BinaryWriter( FILE *file_ ) : _file( file_ ), _pos( 0 ), _ok( file_ != nullptr ) {}
+
+    bool           ok() const { return _ok ; }
+    uint64_t       pos() const { return _pos ; }
+
+    void           bytes( const void *p, size_t n ) { raw( p, n ) ; }
+    void           u32( uint32_t v ) { swapped( &v, 1 ) ; }
+    void           u64( uint64_t v ) { swapped( &v, 1 ) ; }
+    void           pad()
+                   {
+                     static const uint8_t  zero[8] = { 0 } ;
+                     raw( zero, (size_t)((8 - (_pos & 7)) & 7) ) ;
+                   }
+
+    template <typename T>
+    void           array( const T *p, size_t count )
+                   {
+                     u64( (uint64_t)(count * sizeof(T)) ) ;
+                     swapped( p, count ) ;
+                     pad() ;
+                   }
+    void           chars( const char *p, size_t count )
+                   {
+                     u64( (uint64_t)count ) ;
+                     raw( p, count ) ;
+                     pad() ;
+                   }
+} ; // class BinaryWriter
+
+// class:  BinaryReader
+// desc:   bounds-checked cursor over a mapped little-endian image; arrays
+//         come back as pointers into the image, nothing is copied
+//
+class BinaryReader
+{
+  private :
+    const uint8_t *_p ;
+    const uint8_t *_end ;
+    bool           _ok ;
+
+  public  :
+                   BinaryReader( const uint8_t *p_, size_t n ) : _p( p_ ), _end( p_ + n ), _ok( p_ != nullptr ) {}
+
+    bool           ok() const { return _ok ; }
+
+    const uint8_t *bytes( size_t n )
+                   {
+                     if (!_ok || (size_t)(_end - _p) < n)
+                     {
+                       _ok = false ;
+                       return nullptr ;
+                     }
+                     const uint8_t  *r = _p ;
+                     _p += n ;
+                     return r ;
+                   }
+    uint32_t       u32()
+                   {
+                     const uint8_t  *b = bytes( 4 ) ;
+                     return b ? (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24) : 0 ;
+                   }
+    uint64_t       u64()
+                   {
+                     uint64_t  lo = u32() ;
+                     uint64_t  hi = u32() ;
+                     return lo | (hi << 32) ;
+                   }
+    void           pad()
+                   {
+                     size_t  off = (size_t)((uintptr_t)_p & 7) ;
+                     if (off != 0)
+                       bytes( 8 - off ) ;
+                   }
+
+    // zero-copy; 'count' receives the element count
+    template <typename T>
+    const T       *array( size_t &count )
+                   {
+                     uint64_t        n = u64() ;
+                     const uint8_t  *b = (n % sizeof(T) == 0) ? bytes( (size_t)n ) : nullptr ;
+                     if (b == nullptr)
+                       _ok = false ;
+                     pad() ;
+                     count = _ok ? (size_t)(n / sizeof(T)) : 0 ;
+                     return _ok ? (const T*)b : nullptr ;
+                   }
+} ; // class BinaryReader
+
+}} ; // namespace
+
+#endif
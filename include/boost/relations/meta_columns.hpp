@@ -0,0 +1,445 @@
+/*!
+  @file       meta_columns.hpp
+  @brief      Columnar meta values by slot, scan kernels and selection bitmaps
+
+  @author     Robert McInnis
+  @date       september 21, 2016
+  @par        copyright (c) 2016 Solid ICE Technologies, Inc.  All rights reserved.
+
+  Distributed under the Boost Software License, Version 1.0. (See accompanying
+  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+*/
+#ifndef META_COLUMNS_HPP
+#define META_COLUMNS_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/relations/symbol.hpp>
+
+// the scan kernels have an AVX2 version, compiled with a target attribute
+// and picked at run time, so the headers need no -mavx2.  define
+// BOOST_RELATIONS_NO_SIMD to always use the portable loops
+//
+#if !defined(BOOST_RELATIONS_NO_SIMD) && (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define BOOST_RELATIONS_AVX2 1
+#include <immintrin.h>
+#else
+#define BOOST_RELATIONS_AVX2 0
+#endif
+
+// bit counting is guarded on the compiler, not the ISA: the builtins pick
+// the best instruction for the target on their own.  MSVC's __popcnt64
+// assumes POPCNT, which x64 CPUs have had since 2008
+//
+#if defined(_MSC_VER) && !defined(__clang__) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+namespace boost { namespace relations {
+
+// func:   popcount64 / ctz64
+// desc:   set bits in 'w', and the index of its lowest set bit ('w' != 0);
+//         compiler builtins where there are any, portable bit twiddling
+//         otherwise
+//
+inline uint32_t popcount64( uint64_t w )
+{
+#if defined(__GNUC__) || defined(__clang__)
+  return (uint32_t)__builtin_popcountll( w ) ;
+#elif defined(_MSC_VER) && defined(_M_X64)
+  return (uint32_t)__popcnt64( w ) ;
+#else
+  w = w - ((w >> 1) & 0x5555555555555555ull) ;
+  w = (w & 0x3333333333333333ull) + ((w >> 2) & 0x3333333333333333ull) ;
+  w = (w + (w >> 4)) & 0x0f0f0f0f0f0f0f0full ;
+  return (uint32_t)((w * 0x0101010101010101ull) >> 56) ;
+#endif
+} // :: popcount64
+
+inline uint32_t ctz64( uint64_t w )
+{
+#if defined(__GNUC__) || defined(__clang__)
+  return (uint32_t)__builtin_ctzll( w ) ;
+#elif defined(_MSC_VER) && defined(_M_X64)
+  unsigned long  bit ;
+  _BitScanForward64( &bit, w ) ;
+  return (uint32_t)bit ;
+#else
+  return popcount64( (w & (0 - w)) - 1 ) ;
+#endif
+} // :: ctz64
+
+// class:  Selection
+// desc:   one bit per entity slot.  produced by the meta scans, combined
+//         with the usual set operators, then turned into ids or walked slot
+//         by slot.  selections combined together must have the same size
+//
+class Selection
+{
+  private :
+    std::vector<uint64_t>  _words ;
+    uint32_t               _size ;
+
+    void           trim()
+                   {
+                     if (_size % 64 != 0)
+                       _words.back() &= ((uint64_t)1 << (_size % 64)) - 1 ;
+                   }
+
+  public  :
+                   Selection( uint32_t size_ = 0 ) : _words( (size_ + 63) / 64, 0 ), _size( size_ ) {}
+
+    // all clear, 'size_' bits
+    void           reset( uint32_t size_ )
+                   {
+                     _words.assign( (size_ + 63) / 64, 0 ) ;
+                     _size = size_ ;
+                   }
+    uint32_t       size() const { return _size ; }
+
+    void           set( uint32_t i )   { _words[i / 64] |= (uint64_t)1 << (i % 64) ; }
+    void           clear( uint32_t i ) { _words[i / 64] &= ~((uint64_t)1 << (i % 64)) ; }
+    bool           test( uint32_t i ) const { return (_words[i / 64] >> (i % 64)) & 1 ; }
+
+    uint64_t      *words()       { return _words.data() ; }
+    const uint64_t *words() const { return _words.data() ; }
+    size_t         word_count() const { return _words.size() ; }
+
+    uint32_t       count() const
+                   {
+                     uint32_t  n = 0 ;
+                     for (size_t w = 0; w < _words.size(); w++)
+                       n += popcount64( _words[w] ) ;
+                     return n ;
+                   }
+    bool           any() const
+                   {
+                     for (size_t w = 0; w < _words.size(); w++)
+                     {
+                       if (_words[w] != 0)
+                         return true ;
+                     }
+                     return false ;
+                   }
+
+    Selection     &operator&= ( const Selection &o )
+                   {
+                     for (size_t w = 0; w < _words.size(); w++)
+                       _words[w] &= o._words[w] ;
+                     return *this ;
+                   }
+    Selection     &operator|= ( const Selection &o )
+                   {
+                     for (size_t w = 0; w < _words.size(); w++)
+                       _words[w] |= o._words[w] ;
+                     return *this ;
+                   }
+    // clear every bit set in 'o'
+    Selection     &subtract( const Selection &o )
+                   {
+                     for (size_t w = 0; w < _words.size(); w++)
+                       _words[w] &= ~o._words[w] ;
+                     return *this ;
+                   }
+    Selection     &flip()
+                   {
+                     for (size_t w = 0; w < _words.size(); w++)
+                       _words[w] = ~_words[w] ;
+                     if (!_words.empty())
+                       trim() ;
+                     return *this ;
+                   }
+
+    // fn( slot ) for each set bit, ascending
+    template <typename Fn>
+    void           for_each( Fn fn ) const
+                   {
+                     for (size_t w = 0; w < _words.size(); w++)
+                     {
+                       for (uint64_t bits = _words[w]; bits != 0; bits &= bits - 1)
+                         fn( (uint32_t)(w * 64 + ctz64( bits ))) ;
+                     }
+                   }
+} ; // class Selection
+
+//-----------------------------------------------------------------------------
+// scan kernels: bit i of out[] is set where col[i] matches.  'n' is a
+// multiple of 64; the caller handles the tail
+//
+
+// func:   scan_eq_scalar / scan_in_scalar / scan_lookup
+// desc:   portable versions.  scan_lookup tests each id against a bitmap of
+//         wanted value ids, for sets too large to compare one by one
+//
+inline void scan_eq_scalar( const uint32_t *col, size_t n, uint32_t v, uint64_t *out )
+{
+  for (size_t w = 0; w < n / 64; w++)
+  {
+    uint64_t  bits = 0 ;
+    for (uint32_t j = 0; j < 64; j++)
+      bits |= (uint64_t)(col[w * 64 + j] == v) << j ;
+    out[w] = bits ;
+  }
+} // :: scan_eq_scalar
+
+inline void scan_in_scalar( const uint32_t *col, size_t n, const uint32_t *vs, uint32_t k, uint64_t *out )
+{
+  for (size_t w = 0; w < n / 64; w++)
+  {
+    uint64_t  bits = 0 ;
+    for (uint32_t j = 0; j < 64; j++)
+    {
+      uint32_t  x   = col[w * 64 + j] ;
+      bool      hit = false ;
+      for (uint32_t i = 0; i < k; i++)
+        hit |= (x == vs[i]) ;
+      bits |= (uint64_t)hit << j ;
+    }
+    out[w] = bits ;
+  }
+} // :: scan_in_scalar
+
+inline void scan_lookup( const uint32_t *col, size_t n, const uint64_t *wanted, uint32_t wanted_bits, uint64_t *out )
+{
+  for (size_t w = 0; w < n / 64; w++)
+  {
+    uint64_t  bits = 0 ;
+    for (uint32_t j = 0; j < 64; j++)
+    {
+      uint32_t  x = col[w * 64 + j] ;
+      bits |= (uint64_t)(x < wanted_bits && ((wanted[x / 64] >> (x % 64)) & 1)) << j ;
+    }
+    out[w] = bits ;
+  }
+} // :: scan_lookup
+
+#if BOOST_RELATIONS_AVX2
+
+// func:   scan_eq_avx2 / scan_in_avx2
+// desc:   eight ids per compare; each compare's movemask is 8 result bits
+//
+__attribute__((target("avx2")))
+inline void scan_eq_avx2( const uint32_t *col, size_t n, uint32_t v, uint64_t *out )
+{
+  __m256i  needle = _mm256_set1_epi32( (int)v ) ;
+  for (size_t w = 0; w < n / 64; w++)
+  {
+    uint64_t  bits = 0 ;
+    for (uint32_t j = 0; j < 8; j++)
+    {
+      __m256i  x = _mm256_loadu_si256( (const __m256i*)(col + w * 64 + j * 8) ) ;
+      __m256i  m = _mm256_cmpeq_epi32( x, needle ) ;
+      bits |= (uint64_t)(uint32_t)_mm256_movemask_ps( _mm256_castsi256_ps( m )) << (j * 8) ;
+    }
+    out[w] = bits ;
+  }
+} // :: scan_eq_avx2
+
+__attribute__((target("avx2")))
+inline void scan_in_avx2( const uint32_t *col, size_t n, const uint32_t *vs, uint32_t k, uint64_t *out )
+{
+  __m256i  needle[8] ;
+  for (uint32_t i = 0; i < k; i++)
+    needle[i] = _mm256_set1_epi32( (int)vs[i] ) ;
+  for (size_t w = 0; w < n / 64; w++)
+  {
+    uint64_t  bits = 0 ;
+    for (uint32_t j = 0; j < 8; j++)
+    {
+      __m256i  x = _mm256_loadu_si256( (const __m256i*)(col + w * 64 + j * 8) ) ;
+      __m256i  m = _mm256_cmpeq_epi32( x, needle[0] ) ;
+      for (uint32_t i = 1; i < k; i++)
+        m = _mm256_or_si256( m, _mm256_cmpeq_epi32( x, needle[i] )) ;
+      bits |= (uint64_t)(uint32_t)_mm256_movemask_ps( _mm256_castsi256_ps( m )) << (j * 8) ;
+    }
+    out[w] = bits ;
+  }
+} // :: scan_in_avx2
+
+#endif
+
+// func:   simd_enabled
+// desc:   true when the scans run the AVX2 kernels on this machine
+//
+inline bool simd_enabled()
+{
+#if BOOST_RELATIONS_AVX2
+  static const bool  avx2 = __builtin_cpu_supports( "avx2" ) ;
+  return avx2 ;
+#else
+  return false ;
+#endif
+} // :: simd_enabled
+
+// class:  MetaColumn
+// desc:   the values of one meta key laid out by entity slot, so a filter
+//         over the whole population is a sequential scan of 4 bytes per
+//         entity.  a slot holds its value id, 'none', or 'multi' when the
+//         entity has several values under the key; those keep their values
+//         on the side and are patched into each scan's result.  the column
+//         only grows as far as the highest slot given a value
+//
+class MetaColumn
+{
+  public  :
+    static const uint32_t none  = 0xffffffff ;
+    static const uint32_t multi = 0xfffffffe ;
+
+    // value sets up to this size are compared directly; larger ones go
+    // through a bitmap over value ids
+    static const uint32_t max_compare = 8 ;
+
+  private :
+    typedef std::unordered_map< uint32_t, std::vector<MetaValue> >  MultiMap ;
+
+    std::vector<uint32_t>  _ids ;    // by slot
+    MultiMap               _multi ;  // slot -> values, where _ids[slot] == multi
+
+    // out[] already holds the bits for [0, _ids.size()); sets those of the
+    // multi-valued slots that hold any of 'vs'
+    void           patch( const MetaValue *vs, size_t k, uint64_t *out ) const
+                   {
+                     for (MultiMap::const_iterator it = _multi.begin(); it != _multi.end(); it++)
+                     {
+                       const std::vector<MetaValue>  &values = (*it).second ;
+                       for (size_t i = 0; i < k; i++)
+                       {
+                         if (std::find( values.begin(), values.end(), vs[i] ) != values.end())
+                         {
+                           out[(*it).first / 64] |= (uint64_t)1 << ((*it).first % 64) ;
+                           break ;
+                         }
+                       }
+                     }
+                   }
+
+    // bits for the partial last word, from the same test as the kernels
+    template <typename Match>
+    void           tail( size_t from, uint64_t *out, Match match ) const
+                   {
+                     uint64_t  bits = 0 ;
+                     for (size_t i = from; i < _ids.size(); i++)
+                       bits |= (uint64_t)match( _ids[i] ) << (i - from) ;
+                     if (from < _ids.size())
+                       out[from / 64] = bits ;
+                   }
+
+  public  :
+                   MetaColumn() {}
+
+    uint32_t       slots() const { return (uint32_t)_ids.size() ; }
+
+    void           add( uint32_t slot, MetaValue v )
+                   {
+                     if (slot >= _ids.size())
+                       _ids.resize( slot + 1, (uint32_t)none ) ;
+                     uint32_t  &x = _ids[slot] ;
+                     if (x == none)
+                       x = v.id() ;
+                     else if (x == multi)
+                     {
+                       std::vector<MetaValue>  &values = _multi[slot] ;
+                       if (std::find( values.begin(), values.end(), v ) == values.end())
+                         values.push_back( v ) ;
+                     }
+                     else if (x != v.id())
+                     {
+                       std::vector<MetaValue>  &values = _multi[slot] ;
+                       values.push_back( MetaValue( x )) ;
+                       values.push_back( v ) ;
+                       x = multi ;
+                     }
+                   }
+    void           remove( uint32_t slot, MetaValue v )
+                   {
+                     if (slot >= _ids.size())
+                       return ;
+                     uint32_t  &x = _ids[slot] ;
+                     if (x == v.id())
+                       x = none ;
+                     else if (x == multi)
+                     {
+                       MultiMap::iterator       it     = _multi.find( slot ) ;
+                       std::vector<MetaValue>  &values = (*it).second ;
+                       values.erase( std::remove( values.begin(), values.end(), v ), values.end() ) ;
+                       if (values.size() == 1)
+                       {
+                         x = values[0].id() ;
+                         _multi.erase( it ) ;
+                       }
+                     }
+                   }
+    void           clear()
+                   {
+                     _ids.clear() ;
+                     _multi.clear() ;
+                   }
+
+    // the value of 'slot' when it has exactly one; 'none' or 'multi' otherwise
+    uint32_t       at( uint32_t slot ) const { return (slot < _ids.size()) ? _ids[slot] : none ; }
+
+    // out[] covers at least slots() bits and is all clear beyond them
+    void           select( MetaValue v, uint64_t *out ) const
+                   {
+                     size_t  n = _ids.size() & ~(size_t)63 ;
+#if BOOST_RELATIONS_AVX2
+                     if (simd_enabled())
+                       scan_eq_avx2( _ids.data(), n, v.id(), out ) ;
+                     else
+#endif
+                       scan_eq_scalar( _ids.data(), n, v.id(), out ) ;
+                     uint32_t  id = v.id() ;
+                     tail( n, out, [id]( uint32_t x ) { return x == id ; } ) ;
+                     patch( &v, 1, out ) ;
+                   }
+    // any of 'vs'
+    void           select( const std::vector<MetaValue> &vs, uint64_t *out ) const
+                   {
+                     size_t  n = _ids.size() & ~(size_t)63 ;
+                     if (vs.empty())
+                       return ;
+                     if (vs.size() <= max_compare)
+                     {
+                       uint32_t  ids[max_compare] ;
+                       uint32_t  k = (uint32_t)vs.size() ;
+                       for (uint32_t i = 0; i < k; i++)
+                         ids[i] = vs[i].id() ;
+#if BOOST_RELATIONS_AVX2
+                       if (simd_enabled())
+                         scan_in_avx2( _ids.data(), n, ids, k, out ) ;
+                       else
+#endif
+                         scan_in_scalar( _ids.data(), n, ids, k, out ) ;
+                       tail( n, out, [&ids, k]( uint32_t x ) { return std::find( ids, ids + k, x ) != ids + k ; } ) ;
+                     }
+                     else
+                     {
+                       uint32_t               bound = 0 ;
+                       std::vector<uint64_t>  wanted ;
+                       for (size_t i = 0; i < vs.size(); i++)
+                         bound = std::max( bound, vs[i].id() + 1 ) ;
+                       wanted.assign( (bound + 63) / 64, 0 ) ;
+                       for (size_t i = 0; i < vs.size(); i++)
+                         wanted[vs[i].id() / 64] |= (uint64_t)1 << (vs[i].id() % 64) ;
+                       scan_lookup( _ids.data(), n, wanted.data(), bound, out ) ;
+                       const uint64_t  *bits = wanted.data() ;
+                       tail( n, out, [bits, bound]( uint32_t x ) { return x < bound && ((bits[x / 64] >> (x % 64)) & 1) ; } ) ;
+                     }
+                     patch( vs.data(), vs.size(), out ) ;
+                   }
+
+    size_t         memory_bytes() const
+                   {
+                     size_t  bytes = _ids.capacity() * sizeof(uint32_t) + _multi.bucket_count() * sizeof(void*) ;
+                     for (MultiMap::const_iterator it = _multi.begin(); it != _multi.end(); it++)
+                       bytes += 4 * sizeof(void*) + (*it).second.capacity() * sizeof(MetaValue) ;
+                     return bytes ;
+                   }
+} ; // class MetaColumn
+
+}} ; // namespace
+
+#endif
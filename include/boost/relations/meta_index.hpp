@@ -0,0 +1,286 @@
+/*!
+  @file       meta_index.hpp
+  @brief      Inverted meta index: (key, value) -> sorted entity id postings
+
+  @author     Robert McInnis
+  @date       september 21, 2016
+  @par        copyright (c) 2016 Solid ICE Technologies, Inc.  All rights reserved.
+
+  Distributed under the Boost Software License, Version 1.0. (See accompanying
+  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+*/
+#ifndef META_INDEX_HPP
+#define META_INDEX_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/relations/meta_columns.hpp>
+#include <boost/relations/span.hpp>
+#include <boost/relations/stats.hpp>
+#include <boost/relations/symbol.hpp>
+
+namespace boost { namespace relations {
+
+typedef std::vector<uint32_t>                      IdVec ;
+typedef std::vector<uint32_t>::iterator            IdVec_iter ;
+
+typedef std::pair<MetaKey, std::string>            MetaTerm ;
+typedef std::vector<MetaTerm>                      MetaTermVec ;
+typedef std::vector<MetaTerm>::const_iterator      MetaTermVec_iter ;
+
+// class:  MetaIndex
+// desc:   optional inverted index over selected meta keys.  each indexed key
+//         maps a value id to the ids of the entities carrying it.  ids are
+//         appended as meta is written and sorted lazily on the first query
+//         after a change, so a bulk load in any id order stays O(1) per
+//         value.  a key may also keep a MetaColumn, its values by entity
+//         slot, for whole-population scans.  adds lock the key, so loader
+//         threads may write meta concurrently; queries must not overlap
+//         writes to the same key
+//
+class MetaIndex
+{
+  private :
+    struct Postings
+    {
+      IdVec        ids ;
+      bool         sorted ;
+
+                   Postings() : sorted( true ) {}
+    } ;
+
+    typedef std::unordered_map< MetaValue, Postings, SymbolHash<ValueTag> >            PostingsMap ;
+    typedef std::unordered_map< MetaValue, Postings, SymbolHash<ValueTag> >::iterator  PostingsMap_iter ;
+
+    struct KeyIndex
+    {
+      std::mutex   lock ;
+      bool         postings ;   // 'values' is maintained
+      PostingsMap  values ;
+      std::unique_ptr<MetaColumn> column ;
+
+                   KeyIndex() : postings( false ) {}
+    } ;
+
+    std::vector< std::unique_ptr<KeyIndex> >  _keys ;   // by MetaKey id; null when not indexed
+
+    KeyIndex      *key_index( MetaKey key ) const
+                   {
+                     return (key.valid() && key.id() < _keys.size()) ? _keys[key.id()].get() : nullptr ;
+                   }
+    KeyIndex      &make_key_index( MetaKey key )
+                   {
+                     if (key.id() >= _keys.size())
+                       _keys.resize( key.id() + 1 ) ;
+                     if (!_keys[key.id()])
+                       _keys[key.id()].reset( new KeyIndex() ) ;
+                     return *_keys[key.id()] ;
+                   }
+
+    struct SizeLess
+    {
+      bool         operator() ( const IndexSpan &a, const IndexSpan &b ) const { return a.size() < b.size() ; }
+    } ;
+
+  public  :
+                   MetaIndex() {}
+
+    // start indexing 'key'; returns false if it already was.  not safe
+    // while other threads are writing meta
+    bool           enable( MetaKey key )
+                   {
+                     KeyIndex  &k = make_key_index( key ) ;
+                     if (k.postings)
+                       return false ;
+                     k.postings = true ;
+                     return true ;
+                   }
+    bool           enabled( MetaKey key ) const
+                   {
+                     KeyIndex  *k = key_index( key ) ;
+                     return k != nullptr && k->postings ;
+                   }
+
+    // start keeping a column for 'key'; same rules as enable()
+    bool           enable_column( MetaKey key )
+                   {
+                     KeyIndex  &k = make_key_index( key ) ;
+                     if (k.column)
+                       return false ;
+                     k.column.reset( new MetaColumn() ) ;
+                     return true ;
+                   }
+    const MetaColumn *column( MetaKey key ) const
+                   {
+                     KeyIndex  *k = key_index( key ) ;
+                     return (k == nullptr) ? nullptr : k->column.get() ;
+                   }
+
+    // drops every posting and column entry; keys stay enabled
+    void           clear()
+                   {
+                     for (size_t i = 0; i < _keys.size(); i++)
+                     {
+                       if (!_keys[i])
+                         continue ;
+                       _keys[i]->values.clear() ;
+                       if (_keys[i]->column)
+                         _keys[i]->column->clear() ;
+                     }
+                   }
+
+    // postings and the hash nodes holding them
+    size_t         memory_bytes() const
+                   {
+                     size_t  bytes = _keys.capacity() * sizeof(_keys[0]) ;
+                     for (size_t i = 0; i < _keys.size(); i++)
+                     {
+                       if (!_keys[i])
+                         continue ;
+                       const PostingsMap  &values = _keys[i]->values ;
+                       bytes += sizeof(KeyIndex) + values.bucket_count() * sizeof(void*) ;
+                       if (_keys[i]->column)
+                         bytes += sizeof(MetaColumn) + _keys[i]->column->memory_bytes() ;
+                       for (PostingsMap::const_iterator it = values.begin(); it != values.end(); it++)
+                         bytes += hash_node_bytes + sizeof(PostingsMap::value_type) + (*it).second.ids.capacity() * sizeof(uint32_t) ;
+                     }
+                     return bytes ;
+                   }
+
+    // what add() updates; enabling one part on a key backfills just that part
+    static const uint32_t postings_part = 1 ;
+    static const uint32_t column_part   = 2 ;
+    static const uint32_t all_parts     = 3 ;
+
+    // called by Entity::meta for each value newly added to an entity
+    void           add( MetaKey key, MetaValue value, uint32_t id, uint32_t slot, uint32_t parts = all_parts )
+                   {
+                     KeyIndex  *k = key_index( key ) ;
+                     if (k == nullptr)
+                       return ;
+                     std::lock_guard<std::mutex>  guard( k->lock ) ;
+                     if (k->column && (parts & column_part))
+                       k->column->add( slot, value ) ;
+                     if (!k->postings || !(parts & postings_part))
+                       return ;
+                     Postings  &p = k->values[value] ;
+                     if (!p.ids.empty() && p.ids.back() >= id)
+                       p.sorted = false ;
+                     p.ids.push_back( id ) ;
+                   }
+    void           remove( MetaKey key, MetaValue value, uint32_t id, uint32_t slot )
+                   {
+                     KeyIndex  *k = key_index( key ) ;
+                     if (k == nullptr)
+                       return ;
+                     std::lock_guard<std::mutex>  guard( k->lock ) ;
+                     if (k->column)
+                       k->column->remove( slot, value ) ;
+                     PostingsMap_iter  it = k->values.find( value ) ;
+                     if (it == k->values.end())
+                       return ;
+                     // an id is posted once per value, so erase just its own
+                     // entry; a list still unsorted from adds is sorted here, as
+                     // the next find() would do
+                     Postings  &p = (*it).second ;
+                     if (!p.sorted)
+                     {
+                       std::sort( p.ids.begin(), p.ids.end() ) ;
+                       p.sorted = true ;
+                     }
+                     IdVec_iter  pos = std::lower_bound( p.ids.begin(), p.ids.end(), id ) ;
+                     if (pos == p.ids.end() || *pos != id)
+                       return ;
+                     p.ids.erase( pos ) ;
+                     if (p.ids.empty())
+                       k->values.erase( it ) ;
+                   }
+
+    // ascending ids of the entities with 'value' under 'key'.  the span is
+    // valid until the next write to 'key'
+    IndexSpan      find( MetaKey key, MetaValue value ) const
+                   {
+                     KeyIndex  *k = key_index( key ) ;
+                     if (k == nullptr || !k->postings || !value.valid())
+                       return IndexSpan() ;
+                     std::lock_guard<std::mutex>  guard( k->lock ) ;
+                     PostingsMap_iter  it = k->values.find( value ) ;
+                     if (it == k->values.end())
+                       return IndexSpan() ;
+                     Postings  &p = (*it).second ;
+                     if (!p.sorted)
+                     {
+                       std::sort( p.ids.begin(), p.ids.end() ) ;
+                       p.sorted = true ;
+                     }
+                     return IndexSpan( p.ids.data(), p.ids.data() + p.ids.size() ) ;
+                   }
+    IndexSpan      find( MetaKey key, const std::string &value ) const
+                   {
+                     return find( key, MetaValue::find( value )) ;
+                   }
+
+    // ids present in every term.  false if some key isn't indexed (the
+    // caller has to scan); 'out' is ascending
+    bool           find( const MetaTermVec &terms, IdVec &out ) const
+                   {
+                     std::vector<IndexSpan>  lists ;
+
+                     out.clear() ;
+                     lists.reserve( terms.size() ) ;
+                     for (MetaTermVec_iter it = terms.begin(); it != terms.end(); it++)
+                     {
+                       if (!enabled( (*it).first ))
+                         return false ;
+                       lists.push_back( find( (*it).first, (*it).second )) ;
+                     }
+                     intersect( lists, out ) ;
+                     return true ;
+                   }
+
+    // intersection of ascending id lists.  walks the shortest list and
+    // gallops through the others, so a rare value against a common one
+    // costs O(short * log(long))
+    static void    intersect( std::vector<IndexSpan> lists, IdVec &out )
+                   {
+                     out.clear() ;
+                     if (lists.empty())
+                       return ;
+                     std::sort( lists.begin(), lists.end(), SizeLess() ) ;
+
+                     std::vector<const uint32_t*>  cursor( lists.size() ) ;
+                     for (size_t l = 0; l < lists.size(); l++)
+                       cursor[l] = lists[l].begin() ;
+
+                     for (const uint32_t *p = lists[0].begin(); p != lists[0].end(); p++)
+                     {
+                       bool  all = true ;
+                       for (size_t l = 1; l < lists.size() && all; l++)
+                       {
+                         const uint32_t  *c    = cursor[l] ;
+                         const uint32_t  *last = lists[l].end() ;
+                         size_t           step = 1 ;
+                         while (c + step < last && c[step] < *p)
+                           step *= 2 ;
+                         c = std::lower_bound( c + step / 2, std::min( c + step + 1, last ), *p ) ;
+                         cursor[l] = c ;
+                         if (c == last)
+                           return ;
+                         all = (*c == *p) ;
+                       }
+                       if (all && (out.empty() || out.back() != *p))
+                         out.push_back( *p ) ;
+                     }
+                   }
+} ; // class MetaIndex
+
+}} ; // namespace
+
+#endif
@@ -0,0 +1,131 @@
+/*!
+  @file       meta_set.hpp
+  @brief      Compact per-entity meta storage: interned (key, value) pairs
+
+  @author     Robert McInnis
+  @date       september 21, 2016
+  @par        copyright (c) 2016 Solid ICE Technologies, Inc.  All rights reserved.
+
+  Distributed under the Boost Software License, Version 1.0. (See accompanying
+  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+*/
+#ifndef META_SET_HPP
+#define META_SET_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+#include <boost/relations/span.hpp>
+#include <boost/relations/symbol.hpp>
+
+namespace boost { namespace relations {
+
+// struct: MetaPair
+// desc:   one meta value of an entity; both halves are interned ids
+//
+struct MetaPair
+{
+  MetaKey          key ;
+  MetaValue        value ;
+
+                   MetaPair() {}
+                   MetaPair( MetaKey key_, MetaValue value_ ) : key( key_ ), value( value_ ) {}
+} ; // struct MetaPair
+
+typedef Span<MetaPair>     MetaSpan ;
+
+// class:  MetaSet
+// desc:   an entity's meta as (key, value) pairs ordered by key, values of a
+//         key in the order they were added.  the first 'inline_pairs' live
+//         in the object itself, which covers most entities; beyond that the
+//         pairs move to one heap block that doubles as it fills
+//
+class MetaSet
+{
+  public  :
+    static const uint32_t inline_pairs = 3 ;
+
+  private :
+    uint32_t       _size ;
+    uint32_t       _capacity ;
+    MetaPair      *_heap ;                 // nullptr while the pairs fit inline
+    MetaPair       _inline[inline_pairs] ;
+
+                   MetaSet( const MetaSet & ) ;
+    MetaSet       &operator= ( const MetaSet & ) ;
+
+    MetaPair      *data() { return _heap ? _heap : _inline ; }
+
+    struct KeyLess
+    {
+      bool         operator() ( const MetaPair &a, MetaKey b ) const { return a.key < b ; }
+      bool         operator() ( MetaKey a, const MetaPair &b ) const { return a < b.key ; }
+    } ;
+
+    void           grow()
+                   {
+                     uint32_t   capacity = _capacity * 2 ;
+                     MetaPair  *heap     = new MetaPair[capacity] ;
+                     std::copy( begin(), end(), heap ) ;
+                     delete [] _heap ;
+                     _heap     = heap ;
+                     _capacity = capacity ;
+                   }
+
+  public  :
+                   MetaSet() : _size( 0 ), _capacity( inline_pairs ), _heap( nullptr ) {}
+                  ~MetaSet() { delete [] _heap ; }
+
+    const MetaPair *begin() const { return _heap ? _heap : _inline ; }
+    const MetaPair *end()   const { return begin() + _size ; }
+    uint32_t       size()  const { return _size ; }
+    bool           empty() const { return _size == 0 ; }
+
+    // the values of 'key', oldest first; empty if it has none
+    MetaSpan       find( MetaKey key ) const
+                   {
+                     std::pair<const MetaPair*, const MetaPair*>  r = std::equal_range( begin(), end(), key, KeyLess() ) ;
+                     return MetaSpan( r.first, r.second ) ;
+                   }
+    bool           contains( MetaKey key, MetaValue value ) const
+                   {
+                     MetaSpan  s = find( key ) ;
+                     for (const MetaPair *p = s.begin(); p != s.end(); p++)
+                     {
+                       if ((*p).value == value)
+                         return true ;
+                     }
+                     return false ;
+                   }
+
+    // false if the pair was already there
+    bool           insert( MetaKey key, MetaValue value )
+                   {
+                     if (contains( key, value ))
+                       return false ;
+                     if (_size == _capacity)
+                       grow() ;
+                     MetaPair  *first = data() ;
+                     MetaPair  *pos   = std::upper_bound( first, first + _size, key, KeyLess() ) ;
+                     std::copy_backward( pos, first + _size, first + _size + 1 ) ;
+                     *pos = MetaPair( key, value ) ;
+                     _size++ ;
+                     return true ;
+                   }
+
+    void           clear()
+                   {
+                     delete [] _heap ;
+                     _heap     = nullptr ;
+                     _size     = 0 ;
+                     _capacity = inline_pairs ;
+                   }
+
+    // bytes held outside the object
+    size_t         heap_bytes() const { return _heap ? _capacity * sizeof(MetaPair) : 0 ; }
+} ; // class MetaSet
+
+}} ; // namespace
+
+#endif
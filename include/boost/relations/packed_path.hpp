@@ -0,0 +1,81 @@
+/*!
+  @file       packed_path.hpp
+  @brief      Relation path packed into a single integer
+
+  @author     Robert McInnis
+  @date       september 21, 2016
+  @par        copyright (c) 2016 Solid ICE Technologies, Inc.  All rights reserved.
+
+  Distributed under the Boost Software License, Version 1.0. (See accompanying
+  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+*/
+#ifndef PACKED_PATH_HPP
+#define PACKED_PATH_HPP
+
+#include <cstdint>
+#include <string>
+
+namespace boost { namespace relations {
+
+// class:  PackedPath
+// desc:   a relation path ('ppc' == parent-parent-child) as a value type.
+//         the low nibble holds the length, each following nibble one step
+//         code, so a path is 8 bytes, never allocates and compares as an int
+//
+class PackedPath
+{
+  private :
+    uint64_t       _bits ;
+
+    explicit       PackedPath( uint64_t bits_ ) : _bits( bits_ ) {}
+
+  public  :
+    static const uint32_t max_steps     = 15 ;
+    static const uint32_t bits_per_step = 4 ;
+    static const uint32_t max_codes     = 16 ;
+
+                   PackedPath() : _bits( 0 ) {}
+
+    static PackedPath from_raw( uint64_t bits_ ) { return PackedPath( bits_ ) ; }
+
+    uint32_t       size()  const { return (uint32_t)(_bits & 0xf) ; }
+    bool           empty() const { return size() == 0 ; }
+    bool           full()  const { return size() == max_steps ; }
+    uint64_t       raw()   const { return _bits ; }
+
+    uint8_t        at( uint32_t i ) const { return (uint8_t)((_bits >> (bits_per_step * (i + 1))) & 0xf) ; }
+    uint8_t        back() const { return at( size() - 1 ) ; }
+
+    // caller checks full(); 'code' must be < max_codes
+    PackedPath     push( uint8_t code ) const
+                   {
+                     uint32_t  n = size() ;
+                     return PackedPath( ((_bits & ~(uint64_t)0xf) | ((uint64_t)code << (bits_per_step * (n + 1)))) | (n + 1) ) ;
+                   }
+
+    // 'alphabet' maps step codes to display characters, ie: "cpsS"
+    std::string    str( const char *alphabet ) const
+                   {
+                     std::string  s ;
+                     s.reserve( size() ) ;
+                     for (uint32_t i = 0; i < size(); i++)
+                       s += alphabet[at( i )] ;
+                     return s ;
+                   }
+    char          *str( const char *alphabet, char *buf ) const  // buf >= max_steps + 1
+                   {
+                     uint32_t  i ;
+                     for (i = 0; i < size(); i++)
+                       buf[i] = alphabet[at( i )] ;
+                     buf[i] = '\0' ;
+                     return buf ;
+                   }
+
+    bool           operator== ( const PackedPath &o ) const { return _bits == o._bits ; }
+    bool           operator!= ( const PackedPath &o ) const { return _bits != o._bits ; }
+    bool           operator<  ( const PackedPath &o ) const { return _bits <  o._bits ; }
+} ; // class PackedPath
+
+}} ; // namespace
+
+#endif
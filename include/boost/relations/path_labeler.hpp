@@ -0,0 +1,278 @@
+/*!
+  @file       path_labeler.hpp
+  @brief      Relationship naming: traversal paths -> labels via a compiled trie
+
+  @author     Robert McInnis
+  @date       september 21, 2016
+  @par        copyright (c) 2016 Solid ICE Technologies, Inc.  All rights reserved.
+
+  Distributed under the Boost Software License, Version 1.0. (See accompanying
+  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+*/
+#ifndef PATH_LABELER_HPP
+#define PATH_LABELER_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <boost/relations/entity.hpp>
+#include <boost/relations/packed_path.hpp>
+#include <boost/relations/traversal.hpp>
+
+namespace boost { namespace relations {
+
+// class:  PathLabeler
+// desc:   names the paths produced by a traversal.  rules ("ppc" -> "uncle")
+//         are compiled into a trie over the spec's step codes: a table of
+//         (state, code) -> state plus a label per (state, variant).  the
+//         variant is picked from one meta key of the entity being named
+//         (typically gender), with a fallback column for rules that apply to
+//         every variant.  naming a result walks at most PackedPath::max_steps
+//         table entries and returns a pointer into the labeler, so nothing is
+//         allocated or formatted per row.
+//
+//         add_cousins() expands the open-ended "n-th cousin k times removed"
+//         family into the trie up to the longest path a PackedPath can hold.
+//         later rules replace earlier ones on the same (path, variant)
+//
+class PathLabeler
+{
+  public  :
+    static const uint32_t  no_state   = 0xffffffff ;
+    static const uint8_t   any        = 0 ;        // variant column for unqualified rules
+    static const uint16_t  no_label   = 0xffff ;
+
+  private :
+    uint32_t                   _width ;      // step codes per state
+    MetaKey                    _qualifier ;
+    std::vector<MetaValue>     _variants ;   // variant v + 1 <-> _variants[v]
+    std::vector<uint32_t>      _next ;       // state * _width + code -> state; 0 (the root) == none
+    std::vector<uint16_t>      _labels ;     // state * stride() + variant -> label
+    std::vector<std::string>   _names ;
+    char                       _chars[PackedPath::max_codes + 1] ;
+
+    uint32_t       stride() const { return (uint32_t)_variants.size() + 1 ; }
+    uint32_t       states() const { return (uint32_t)(_next.size() / _width) ; }
+
+    int            code_of( char c ) const
+                   {
+                     const char  *p = strchr( _chars, c ) ;
+                     return (c == '\0' || p == nullptr) ? -1 : (int)(p - _chars) ;
+                   }
+    uint16_t       intern( const std::string &label )
+                   {
+                     for (size_t i = 0; i < _names.size(); i++)
+                     {
+                       if (_names[i] == label)
+                         return (uint16_t)i ;
+                     }
+                     _names.push_back( label ) ;
+                     return (uint16_t)(_names.size() - 1) ;
+                   }
+    // walks (creating states as needed) along 'codes'
+    uint32_t       insert( const uint8_t *codes, size_t n )
+                   {
+                     uint32_t  s = 0 ;
+                     for (size_t i = 0; i < n; i++)
+                     {
+                       uint32_t  &t = _next[s * _width + codes[i]] ;
+                       if (t == 0)
+                       {
+                         t = states() ;
+                         _next.resize( _next.size() + _width, 0 ) ;
+                         _labels.resize( _labels.size() + stride(), (uint16_t)no_label ) ;
+                       }
+                       s = _next[s * _width + codes[i]] ;
+                     }
+                     return s ;
+                   }
+    void           set( const uint8_t *codes, size_t n, uint8_t variant, const std::string &label )
+                   {
+                     uint16_t  l = intern( label ) ;
+                     uint32_t  s = insert( codes, n ) ;
+                     _labels[s * stride() + variant] = l ;
+                   }
+
+    static std::string ordinal( uint32_t n )
+                   {
+                     const char  *suffix = "th" ;
+                     if (n % 100 < 11 || n % 100 > 13)
+                       suffix = (n % 10 == 1) ? "st" : (n % 10 == 2) ? "nd" : (n % 10 == 3) ? "rd" : "th" ;
+                     return std::to_string( n ) + suffix ;
+                   }
+    static std::string cousin( uint32_t degree, uint32_t removed )
+                   {
+                     std::string  s = ordinal( degree ) + " cousin" ;
+                     if (removed == 1)
+                       s += " once removed" ;
+                     else if (removed == 2)
+                       s += " twice removed" ;
+                     else if (removed > 2)
+                       s += " " + std::to_string( removed ) + " times removed" ;
+                     return s ;
+                   }
+
+  public  :
+    // 'qualifier' and 'variants' name the meta key and the values that pick
+    // a label column, e.g. ( "gender", { "female", "male" } )
+                   PathLabeler( const TraversalSpec &spec, MetaKey qualifier_ = MetaKey(),
+                                const std::vector<std::string> &variants_ = std::vector<std::string>() )
+                     : _width( spec.size() ? spec.size() : 1 ), _qualifier( qualifier_ )
+                   {
+                     for (size_t i = 0; i < variants_.size(); i++)
+                       _variants.push_back( MetaValue( variants_[i] )) ;
+                     strcpy( _chars, spec.chars() ) ;
+                     _next.assign( _width, 0 ) ;
+                     _labels.assign( stride(), (uint16_t)no_label ) ;
+                   }
+
+    // 'path' is written in the spec's step characters.  returns false for a
+    // path with unknown characters or an unknown variant
+    bool           add( const std::string &path, const std::string &label )
+                   {
+                     return add( path, std::string(), label ) ;
+                   }
+    bool           add( const std::string &path, const std::string &variant, const std::string &label )
+                   {
+                     uint8_t  codes[PackedPath::max_steps] ;
+                     uint8_t  v = any ;
+
+                     if (path.empty() || path.size() > PackedPath::max_steps)
+                       return false ;
+                     if (!variant.empty())
+                     {
+                       v = variant_of( variant ) ;
+                       if (v == any)
+                         return false ;
+                     }
+                     for (size_t i = 0; i < path.size(); i++)
+                     {
+                       int  c = code_of( path[i] ) ;
+                       if (c < 0)
+                         return false ;
+                       codes[i] = (uint8_t)c ;
+                     }
+                     set( codes, path.size(), v, label ) ;
+                     return true ;
+                   }
+
+    // cousins through a common ancestor: 'up' a times then 'down' b times
+    // with a, b >= 2 is the (min(a, b) - 1)th cousin, |a - b| times removed.
+    // when the spec also walks siblings, up^a 'sibling' down^b counts as
+    // up^(a + 1) down^(b + 1).  returns false for unknown step characters
+    bool           add_cousins( char up, char down, char sibling = '\0' )
+                   {
+                     int      u = code_of( up ) ;
+                     int      d = code_of( down ) ;
+                     int      s = code_of( sibling ) ;
+                     uint8_t  codes[PackedPath::max_steps] ;
+
+                     if (u < 0 || d < 0 || (sibling != '\0' && s < 0))
+                       return false ;
+
+                     for (uint32_t a = 2; a < PackedPath::max_steps; a++)
+                     {
+                       for (uint32_t b = 2; a + b <= PackedPath::max_steps; b++)
+                       {
+                         std::string  label = cousin( std::min( a, b ) - 1, (a > b) ? a - b : b - a ) ;
+                         size_t       n     = 0 ;
+
+                         for (uint32_t i = 0; i < a; i++)
+                           codes[n++] = (uint8_t)u ;
+                         for (uint32_t i = 0; i < b; i++)
+                           codes[n++] = (uint8_t)d ;
+                         set( codes, n, any, label ) ;
+
+                         if (s < 0)
+                           continue ;
+                         n = 0 ;
+                         for (uint32_t i = 1; i < a; i++)
+                           codes[n++] = (uint8_t)u ;
+                         codes[n++] = (uint8_t)s ;
+                         for (uint32_t i = 1; i < b; i++)
+                           codes[n++] = (uint8_t)d ;
+                         set( codes, n, any, label ) ;
+                       }
+                     }
+                     return true ;
+                   }
+
+    // variant column for a qualifier value, or 'any'
+    uint8_t        variant_of( const std::string &value ) const
+                   {
+                     return variant_of( MetaValue::find( value )) ;
+                   }
+    uint8_t        variant_of( MetaValue value ) const
+                   {
+                     for (size_t i = 0; i < _variants.size(); i++)
+                     {
+                       if (_variants[i] == value)
+                         return (uint8_t)(i + 1) ;
+                     }
+                     return any ;
+                   }
+    uint8_t        variant_of( Entity &e ) const
+                   {
+                     MetaSpan  values = e.get_meta( _qualifier ) ;
+                     return values.empty() ? any : variant_of( values[0].value ) ;
+                   }
+
+    // incremental form for visitors that label as they walk:
+    // state = step( state, code ) from start(); no_state once off the trie
+    uint32_t       start() const { return 0 ; }
+    uint32_t       step( uint32_t state, uint8_t code ) const
+                   {
+                     if (state == no_state || code >= _width)
+                       return no_state ;
+                     uint32_t  t = _next[state * _width + code] ;
+                     return (t == 0) ? no_state : t ;
+                   }
+    const std::string *label( uint32_t state, uint8_t variant ) const
+                   {
+                     if (state == no_state || variant >= stride())
+                       return nullptr ;
+                     uint16_t  l = _labels[state * stride() + variant] ;
+                     if (l == no_label)
+                       l = _labels[state * stride() + any] ;
+                     return (l == no_label) ? nullptr : &_names[l] ;
+                   }
+
+    // nullptr when no rule matches
+    const std::string *label( PackedPath path, uint8_t variant ) const
+                   {
+                     uint32_t  s = start() ;
+                     for (uint32_t i = 0; i < path.size(); i++)
+                     {
+                       s = step( s, path.at( i )) ;
+                       if (s == no_state)
+                         return nullptr ;
+                     }
+                     return label( s, variant ) ;
+                   }
+    const std::string *label( PackedPath path, Entity &other ) const
+                   {
+                     return label( path, variant_of( other )) ;
+                   }
+    const std::string *label( const std::string &path, uint8_t variant ) const
+                   {
+                     uint32_t  s = start() ;
+                     for (size_t i = 0; i < path.size(); i++)
+                     {
+                       int  c = code_of( path[i] ) ;
+                       s = (c < 0) ? no_state : step( s, (uint8_t)c ) ;
+                       if (s == no_state)
+                         return nullptr ;
+                     }
+                     return path.empty() ? nullptr : label( s, variant ) ;
+                   }
+    const std::string *label( const std::string &path, Entity &other ) const
+                   {
+                     return label( path, variant_of( other )) ;
+                   }
+} ; // class PathLabeler
+
+}} ; // namespace
+
+#endif
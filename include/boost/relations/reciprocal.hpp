@@ -12,6 +12,14 @@
 #ifndef RECIPROCAL_HPP
 #define RECIPROCAL_HPP
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
 #include <boost/relations/entity.hpp>
 
 namespace boost { namespace relations {
@@ -19,12 +27,13 @@ namespace boost { namespace relations {
 class Reciprocal
 {
   public  :
-    std::string    name ;
-    std::string    cond_key ;   // meta condition
-    std::string    cond_value ; // meta condition
+    RelationType   name ;
+    MetaKey        cond_key ;   // meta condition
+    MetaValue      cond_value ; // meta condition
 
                    Reciprocal( const Reciprocal &c ) { *this = c ; }
                    Reciprocal( const std::string &name_ ) : name( name_ ) {}
+                   Reciprocal( RelationType name_ ) : name( name_ ) {}
                    Reciprocal( const std::string &name_, const std::string &meta_key, const std::string &meta_value ) 
                    : name( name_ ), cond_key( meta_key ), cond_value( meta_value ) {}
 
@@ -38,37 +47,76 @@ class Reciprocal
                      }
                      return *this ;
                    }
-    bool           fits( Entity &other ) 
-                   { if (cond_key.empty())  return true ;
-                     MetaVec  *meta = other.get_meta( cond_key ) ;
-                     if (meta == NULL)  return false ;
-                     MetaVec_iter  it ;
-                     for (it = meta->begin(); it != meta->end(); it++)
-                     {
-                       if ((*it) == cond_value)
-                         return true ;
-                     }
-                     return false ;
+    bool           fits( const Entity &other ) const
+                   {
+                     return !cond_key.valid() || other.has_meta( cond_key, cond_value ) ;
                    }
 } ; // class Reciprocal
 
 typedef std::vector<Reciprocal>            ReciprocalVec ;
 typedef std::vector<Reciprocal>::iterator  ReciprocalVec_iter ;
 
-typedef std::map< std::string, ReciprocalVec >               ReciprocalMap ;
-typedef std::map< std::string, ReciprocalVec >::iterator     ReciprocalMap_iter ;
-typedef std::map< std::string, ReciprocalVec >::value_type   ReciprocalMap_pair ;
+typedef std::map< RelationType, ReciprocalVec >              ReciprocalMap ;
+typedef std::map< RelationType, ReciprocalVec >::iterator    ReciprocalMap_iter ;
+typedef std::map< RelationType, ReciprocalVec >::value_type  ReciprocalMap_pair ;
 
+// struct: Edge
+// desc:   one 'from' is-the 'type' (of) 'to' link, for batch application
+//
+struct Edge
+{
+  uint32_t         from ;
+  RelationType     type ;
+  uint32_t         to ;
+
+                   Edge( uint32_t from_, RelationType type_, uint32_t to_ ) : from( from_ ), type( type_ ), to( to_ ) {}
+} ; // struct Edge
+
+typedef std::vector<Edge>            EdgeVec ;
+typedef std::vector<Edge>::iterator  EdgeVec_iter ;
+
+// class:  ReciprocalMgr
+// desc:   reciprocal rules by relation type.  link_with_reciprocals() runs
+//         from a compiled form: rules laid out contiguously per relation id
+//         (CSR style), each carrying the range of rules derived from its own
+//         reciprocal, so applying a link does no map lookups at all.  the
+//         compiled form is rebuilt lazily after the rules change.
+//         link_with_reciprocals() locks both endpoints for the whole update,
+//         so it may be called from several loader threads at once; rules
+//         must not be edited while they run
+//
 class ReciprocalMgr
 {
   private :
-    ReciprocalMap  _ties ;
+    struct Compiled
+    {
+      Reciprocal   rule ;
+      uint32_t     first ;   // derived rules: _derived[first, last)
+      uint32_t     last ;
+
+                   Compiled( const Reciprocal &rule_ ) : rule( rule_ ), first( 0 ), last( 0 ) {}
+    } ;
+
+    ReciprocalMap           _ties ;
+    std::atomic<bool>       _dirty ;
+    std::mutex              _compile_lock ;
+    std::vector<uint32_t>   _offsets ;   // relation id -> _compiled range
+    std::vector<Compiled>   _compiled ;
+    ReciprocalVec           _derived ;
 
   public  :
-                   ReciprocalMgr() {}
+                   ReciprocalMgr() : _dirty( true ) {}
+
+    // non-inserting lookup
+    ReciprocalVec *find( RelationType a )
+                   {
+                     ReciprocalMap_iter it = _ties.find( a ) ;
+                     return (it == _ties.end()) ? nullptr : &(*it).second ;
+                   }
 
-    ReciprocalVec &get( const std::string &a )  // a == 'son' of 'son of parent'
+    ReciprocalVec &get( RelationType a )  // a == 'son' of 'son of parent'
                    {
+                     _dirty = true ;  // caller may edit the rules
                      ReciprocalMap_iter it = _ties.find( a ) ;
                      if (it == _ties.end())
                      {
@@ -77,6 +125,10 @@ class ReciprocalMgr
                      }
                      return (*it).second ;
                    }
+    ReciprocalVec &get( const std::string &a )
+                   {
+                     return get( RelationType( a )) ;
+                   }
 
     void           set( const std::string &a, const std::string &b ) // ie:  'son' of 'parent'; a == 'son' and b == 'parent'
                    {
@@ -90,6 +142,193 @@ class ReciprocalMgr
                    }
 
     uint32_t       size() const { return _ties.size(); }
+
+    // rebuild the compiled rule tables; called on demand by the link methods
+    void           compile()
+                   {
+                     std::lock_guard<std::mutex>  guard( _compile_lock ) ;
+                     if (_dirty == false)
+                       return ;
+
+                     uint32_t  types = 0 ;
+                     for (ReciprocalMap_iter it = _ties.begin(); it != _ties.end(); it++)
+                       types = std::max( types, (*it).first.id() + 1 ) ;
+
+                     _offsets.assign( types + 1, 0 ) ;
+                     _compiled.clear() ;
+                     _derived.clear() ;
+
+                     for (uint32_t t = 0; t < types; t++)
+                     {
+                       _offsets[t] = (uint32_t)_compiled.size() ;
+                       ReciprocalVec  *vec = find( RelationType( t )) ;
+                       if (vec == nullptr)
+                         continue ;
+                       for (ReciprocalVec_iter it = vec->begin(); it != vec->end(); it++)
+                       {
+                         Compiled        c( *it ) ;
+                         ReciprocalVec  *v2 = find( (*it).name ) ;
+
+                         c.first = (uint32_t)_derived.size() ;
+                         if (v2 != nullptr)
+                           _derived.insert( _derived.end(), v2->begin(), v2->end() ) ;
+                         c.last  = (uint32_t)_derived.size() ;
+                         _compiled.push_back( c ) ;
+                       }
+                     }
+                     _offsets[types] = (uint32_t)_compiled.size() ;
+                     _dirty = false ;
+                   }
+
+    // e1.link( type, e2 ) plus every reciprocal rule: each rule that fits e2
+    // links e2 back to e1, and each rule of that reciprocal that fits e1
+    // links e1 to e2 again
+    void           link_with_reciprocals( Entity &e1, RelationType type_, Entity &e2 )
+                   {
+                     BOOST_RELATIONS_TIME( reciprocal_ns ) ;
+                     BOOST_RELATIONS_COUNT( reciprocal_calls, 1 ) ;
+                     if (_dirty)
+                       compile() ;
+                     lock_pair( e1, e2 ) ;
+                     uint32_t  links = apply( e1, type_, e2 ) ;
+                     unlock_pair( e1, e2 ) ;
+                     BOOST_RELATIONS_COUNT( reciprocal_links, links ) ;
+                   }
+    void           link_with_reciprocals( Entity &e1, const std::string &type_, Entity &e2 )
+                   {
+                     link_with_reciprocals( e1, RelationType( type_ ), e2 ) ;
+                   }
+
+    // undo link_with_reciprocals(): drops e1 'type_' e2 and the links its
+    // rules derive.  a derived link may also follow from another link the
+    // pair still has (a 'father' link implies 'parent' just as 'son' does),
+    // so the rules of every remaining link between the two are applied
+    // again.  O(degree of e1 and e2); false if the link wasn't there
+    bool           unlink_with_reciprocals( Entity &e1, RelationType type_, Entity &e2 )
+                   {
+                     if (_dirty)
+                       compile() ;
+                     lock_pair( e1, e2 ) ;
+                     bool  found = e1.unlink( type_, e2 ) ;
+                     if (found)
+                     {
+                       remove( e1, type_, e2 ) ;
+                       restore( e1, e2 ) ;
+                       if (&e1 != &e2)
+                         restore( e2, e1 ) ;
+                     }
+                     unlock_pair( e1, e2 ) ;
+                     return found ;
+                   }
+    bool           unlink_with_reciprocals( Entity &e1, const std::string &type_, Entity &e2 )
+                   {
+                     RelationType  t = RelationType::find( type_ ) ;
+                     return t.valid() && unlink_with_reciprocals( e1, t, e2 ) ;
+                   }
+
+    // batch form; entities are created in 'mgr' as needed
+    void           link_with_reciprocals( EntityMgr &mgr, const EdgeVec &edges )
+                   {
+                     if (_dirty)
+                       compile() ;
+                     for (EdgeVec::const_iterator it = edges.begin(); it != edges.end(); it++)
+                       link_with_reciprocals( mgr.get( (*it).from ), (*it).type, mgr.get( (*it).to )) ;
+                   }
+
+    // 'type_' from every entity in 'from' (slots of 'mgr', e.g. from
+    // EntityMgr::select_meta) to 'to'
+    void           link_with_reciprocals( EntityMgr &mgr, const Selection &from, RelationType type_, Entity &to )
+                   {
+                     if (_dirty)
+                       compile() ;
+                     from.for_each( [&]( uint32_t slot )
+                                    {
+                                      Entity  *e = mgr.at_slot( slot ) ;
+                                      if (!e->erased())
+                                        link_with_reciprocals( *e, type_, to ) ;
+                                    }) ;
+                   }
+
+    // parallel batch form; switches 'mgr' to concurrent mode for the call
+    void           link_with_reciprocals( EntityMgr &mgr, const EdgeVec &edges, ThreadPool &pool )
+                   {
+                     bool  was = mgr.concurrent() ;
+
+                     if (_dirty)
+                       compile() ;
+                     mgr.concurrent( true ) ;
+                     pool.parallel_for( edges.size(), 1024, [&]( unsigned, size_t begin, size_t end )
+                                        {
+                                          for (size_t i = begin; i < end; i++)
+                                            link_with_reciprocals( mgr.get( edges[i].from ), edges[i].type, mgr.get( edges[i].to )) ;
+                                        }) ;
+                     mgr.concurrent( was ) ;
+                   }
+
+  private :
+    // returns the number of link() calls made, the original included
+    uint32_t       apply( Entity &e1, RelationType type_, Entity &e2 )
+                   {
+                     uint32_t  links = 1 ;
+                     if (type_.id() + 1 < _offsets.size())
+                     {
+                       for (uint32_t i = _offsets[type_.id()]; i < _offsets[type_.id() + 1]; i++)
+                       {
+                         Compiled  &c = _compiled[i] ;
+                         if (c.rule.fits( e2 ) == false)
+                           continue ;
+
+                         e2.link( c.rule.name, e1 ) ;
+                         links++ ;
+                         for (uint32_t d = c.first; d < c.last; d++)
+                         {
+                           if (_derived[d].fits( e1 ))
+                           {
+                             e1.link( _derived[d].name, e2 ) ;
+                             links++ ;
+                           }
+                         }
+                       }
+                     }
+                     e1.link( type_, e2 ) ;
+                     return links ;
+                   }
+
+    // the links apply() derives for e1 'type_' e2, removed
+    void           remove( Entity &e1, RelationType type_, Entity &e2 )
+                   {
+                     if (type_.id() + 1 >= _offsets.size())
+                       return ;
+                     for (uint32_t i = _offsets[type_.id()]; i < _offsets[type_.id() + 1]; i++)
+                     {
+                       Compiled  &c = _compiled[i] ;
+                       if (c.rule.fits( e2 ) == false)
+                         continue ;
+
+                       e2.unlink( c.rule.name, e1 ) ;
+                       for (uint32_t d = c.first; d < c.last; d++)
+                       {
+                         if (_derived[d].fits( e1 ))
+                           e1.unlink( _derived[d].name, e2 ) ;
+                       }
+                     }
+                   }
+
+    // re-apply the rules of every link e1 still has to e2
+    void           restore( Entity &e1, Entity &e2 )
+                   {
+                     std::vector<RelationType>  types ;
+
+                     // collect first: apply() may add relation types to e1
+                     RelationMap  &links = e1.relations() ;
+                     for (RelationMap_iter it = links.begin(); it != links.end(); it++)
+                     {
+                       if (e1.is_linked( (*it).first, e2 ))
+                         types.push_back( (*it).first ) ;
+                     }
+                     for (size_t i = 0; i < types.size(); i++)
+                       apply( e1, types[i], e2 ) ;
+                   }
 } ; // class ReciprocalMgr
 
 }} ; // namespace
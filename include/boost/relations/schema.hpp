@@ -0,0 +1,192 @@
+/*!
+  @file       schema.hpp
+  @brief      Relation kinds and reciprocal rules declared as types
+
+  @author     Robert McInnis
+  @date       september 21, 2016
+  @par        copyright (c) 2016 Solid ICE Technologies, Inc.  All rights reserved.
+
+  Distributed under the Boost Software License, Version 1.0. (See accompanying
+  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+  a fixed schema can state its relations as types:
+
+    BOOST_RELATIONS_NAME( Gender, "gender" ) ;
+    BOOST_RELATIONS_NAME( Male  , "male" ) ;
+
+    struct Parent ;
+    struct Father ;
+    struct Son : Relation< Son, Rule<Parent>, Rule< Father, When<Gender, Male> > >
+    {
+      static const char *name() { return "son" ; }
+    } ;
+    ...
+    link<Son>( billy, tommy ) ;
+
+  link<Son> expands to the same links ReciprocalMgr::link_with_reciprocals
+  makes for "son" under the equivalent rules, but the rule set is
+  unrolled at compile time: no rule table, no string hashing, and each
+  relation name is interned once, on first use.  schema_rules() registers
+  the typed rules with a ReciprocalMgr so string-driven paths (loaders,
+  unlink_with_reciprocals) agree with the typed ones
+*/
+#ifndef SCHEMA_HPP
+#define SCHEMA_HPP
+
+#include <cstdint>
+
+#include <boost/relations/entity.hpp>
+#include <boost/relations/reciprocal.hpp>
+#include <boost/relations/stats.hpp>
+
+// a type standing for a meta key or value name
+#define BOOST_RELATIONS_NAME( Type, text ) \
+  struct Type { static const char *name() { return text ; } }
+
+namespace boost { namespace relations {
+
+// struct: Always / When
+// desc:   rule conditions on the entity a rule links from.  When<Key, Value>
+//         holds if the entity has meta Value under Key; both are
+//         BOOST_RELATIONS_NAME types
+//
+struct Always
+{
+  static bool      fits( const Entity & ) { return true ; }
+  static void      add_rule( ReciprocalMgr &mgr, const char *a, const char *b ) { mgr.set( a, b ) ; }
+} ; // struct Always
+
+template <typename Key, typename Value>
+struct When
+{
+  static MetaKey   key()
+                   {
+                     static const MetaKey  k( Key::name() ) ;
+                     return k ;
+                   }
+  static MetaValue value()
+                   {
+                     static const MetaValue  v( Value::name() ) ;
+                     return v ;
+                   }
+  static bool      fits( const Entity &e ) { return e.has_meta( key(), value() ) ; }
+  static void      add_rule( ReciprocalMgr &mgr, const char *a, const char *b ) { mgr.set( a, b, Key::name(), Value::name() ) ; }
+} ; // struct When
+
+// struct: Rule
+// desc:   'Target' is the reciprocal relation, linked back when 'Condition'
+//         fits the other entity; the typed form of Reciprocal
+//
+template <typename Target, typename Condition = Always>
+struct Rule
+{
+  typedef Target      target ;
+  typedef Condition   condition ;
+} ; // struct Rule
+
+template <typename... Rules>
+struct RuleList {} ;
+
+// struct: Relation
+// desc:   CRTP base of a relation kind.  'Self' supplies name(); the rules
+//         follow in the order they are applied
+//
+template <typename Self, typename... Rules>
+struct Relation
+{
+  typedef RuleList<Rules...>  rules ;
+
+  static RelationType type()
+                   {
+                     static const RelationType  t( Self::name() ) ;
+                     return t ;
+                   }
+} ; // struct Relation
+
+// struct: RuleApply
+// desc:   the unrolled body of ReciprocalMgr::apply for one rule list.
+//         forward() applies the rules of e1's relation to e2, each fitting
+//         rule followed by derived(): the fitting rules of its target,
+//         from e1 to e2.  both return the number of links made
+//
+template <typename List>
+struct RuleApply ;
+
+template <>
+struct RuleApply< RuleList<> >
+{
+  static uint32_t  forward( Entity &, Entity & ) { return 0 ; }
+  static uint32_t  derived( Entity &, Entity & ) { return 0 ; }
+  static void      add_rules( ReciprocalMgr &, const char * ) {}
+} ; // struct RuleApply
+
+template <typename R, typename... Rest>
+struct RuleApply< RuleList<R, Rest...> >
+{
+  typedef typename R::target     target ;
+  typedef typename R::condition  condition ;
+
+  static uint32_t  forward( Entity &e1, Entity &e2 )
+                   {
+                     uint32_t  n = 0 ;
+                     if (condition::fits( e2 ))
+                     {
+                       e2.link( target::type(), e1 ) ;
+                       n = 1 + RuleApply<typename target::rules>::derived( e1, e2 ) ;
+                     }
+                     return n + RuleApply< RuleList<Rest...> >::forward( e1, e2 ) ;
+                   }
+  static uint32_t  derived( Entity &e1, Entity &e2 )
+                   {
+                     uint32_t  n = 0 ;
+                     if (condition::fits( e1 ))
+                     {
+                       e1.link( target::type(), e2 ) ;
+                       n = 1 ;
+                     }
+                     return n + RuleApply< RuleList<Rest...> >::derived( e1, e2 ) ;
+                   }
+  static void      add_rules( ReciprocalMgr &mgr, const char *name )
+                   {
+                     condition::add_rule( mgr, name, target::name() ) ;
+                     RuleApply< RuleList<Rest...> >::add_rules( mgr, name ) ;
+                   }
+} ; // struct RuleApply
+
+// func:   link
+// desc:   e1 is-the 'R' of e2, plus every reciprocal of R; locks both ends
+//         like ReciprocalMgr::link_with_reciprocals
+//
+template <typename R>
+void link( Entity &e1, Entity &e2 )
+{
+  BOOST_RELATIONS_TIME( reciprocal_ns ) ;
+  BOOST_RELATIONS_COUNT( reciprocal_calls, 1 ) ;
+
+  lock_pair( e1, e2 ) ;
+  uint32_t  links = 1 + RuleApply<typename R::rules>::forward( e1, e2 ) ;
+  e1.link( R::type(), e2 ) ;
+  unlock_pair( e1, e2 ) ;
+
+  BOOST_RELATIONS_COUNT( reciprocal_links, links ) ;
+} // :: link
+
+template <typename R>
+bool is_linked( Entity &e1, Entity &e2 )
+{
+  return e1.is_linked( R::type(), e2 ) ;
+} // :: is_linked
+
+// func:   schema_rules
+// desc:   registers the rules of each relation kind with 'mgr' as strings
+//
+template <typename... Kinds>
+void schema_rules( ReciprocalMgr &mgr )
+{
+  int  each[] = { 0, (RuleApply<typename Kinds::rules>::add_rules( mgr, Kinds::name() ), 0)... } ;
+  (void)each ;
+} // :: schema_rules
+
+}} ; // namespace
+
+#endif
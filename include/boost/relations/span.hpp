@@ -0,0 +1,43 @@
+/*!
+  @file       span.hpp
+  @brief      Read-only contiguous range view
+
+  @author     Robert McInnis
+  @date       september 21, 2016
+  @par        copyright (c) 2016 Solid ICE Technologies, Inc.  All rights reserved.
+
+  Distributed under the Boost Software License, Version 1.0. (See accompanying
+  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+*/
+#ifndef SPAN_HPP
+#define SPAN_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace boost { namespace relations {
+
+// struct: Span
+// desc:   read-only [first, last) view into contiguous storage
+//
+template <typename T>
+struct Span
+{
+  const T         *first ;
+  const T         *last ;
+
+                   Span() : first( nullptr ), last( nullptr ) {}
+                   Span( const T *first_, const T *last_ ) : first( first_ ), last( last_ ) {}
+
+  const T         *begin() const { return first ; }
+  const T         *end()   const { return last ; }
+  size_t           size()  const { return (size_t)(last - first) ; }
+  bool             empty() const { return first == last ; }
+  const T         &operator[] ( size_t i ) const { return first[i] ; }
+} ; // struct Span
+
+typedef Span<uint32_t>      IndexSpan ;
+
+}} ; // namespace
+
+#endif
@@ -0,0 +1,51 @@
+/*!
+  @file       spin_lock.hpp
+  @brief      One-byte spin lock for short per-entity critical sections
+
+  @author     Robert McInnis
+  @date       september 21, 2016
+  @par        copyright (c) 2016 Solid ICE Technologies, Inc.  All rights reserved.
+
+  Distributed under the Boost Software License, Version 1.0. (See accompanying
+  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+*/
+#ifndef SPIN_LOCK_HPP
+#define SPIN_LOCK_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+namespace boost { namespace relations {
+
+// class:  SpinLock
+// desc:   test-and-test-and-set lock.  a single byte, so it fits in the
+//         padding of an Entity; meant for the few instructions it takes to
+//         append a link, never for blocking work
+//
+class SpinLock
+{
+  private :
+    std::atomic<uint8_t>  _flag ;
+
+                   SpinLock( const SpinLock & ) ;
+    SpinLock      &operator= ( const SpinLock & ) ;
+
+  public  :
+                   SpinLock() : _flag( 0 ) {}
+
+    void           lock()
+                   {
+                     while (_flag.exchange( 1, std::memory_order_acquire ) != 0)
+                     {
+                       while (_flag.load( std::memory_order_relaxed ) != 0)
+                         std::this_thread::yield() ;
+                     }
+                   }
+    bool           try_lock() { return _flag.exchange( 1, std::memory_order_acquire ) == 0 ; }
+    void           unlock()   { _flag.store( 0, std::memory_order_release ) ; }
+} ; // class SpinLock
+
+}} ; // namespace
+
+#endif
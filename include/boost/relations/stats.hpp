@@ -0,0 +1,365 @@
+/*!
+  @file       stats.hpp
+  @brief      Opt-in hot path counters, latency histograms and population stats
+
+  @author     Robert McInnis
+  @date       september 21, 2016
+  @par        copyright (c) 2016 Solid ICE Technologies, Inc.  All rights reserved.
+
+  Distributed under the Boost Software License, Version 1.0. (See accompanying
+  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+*/
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// BOOST_RELATIONS_STATS selects how much the hot paths record:
+//   0 (default)  nothing; every hook compiles away
+//   1            event counters (relaxed atomic increments)
+//   2            counters plus latency histograms (two clock reads per call)
+//
+#ifndef BOOST_RELATIONS_STATS
+#define BOOST_RELATIONS_STATS 0
+#endif
+
+#if BOOST_RELATIONS_STATS >= 1
+#define BOOST_RELATIONS_COUNT( name, n )  (::boost::relations::Stats::global().name.add( n ))
+#define BOOST_RELATIONS_TALLY( var, name ) ::boost::relations::StatTally  var( ::boost::relations::Stats::global().name )
+#else
+#define BOOST_RELATIONS_COUNT( name, n )  ((void)(n))   // 'n' is still evaluated
+#define BOOST_RELATIONS_TALLY( var, name ) ::boost::relations::NullTally  var
+#endif
+
+#if BOOST_RELATIONS_STATS >= 2
+#define BOOST_RELATIONS_TIME( name )      ::boost::relations::ScopedTimer  stats_timer_( ::boost::relations::Stats::global().name )
+#else
+#define BOOST_RELATIONS_TIME( name )      ((void)0)
+#endif
+
+namespace boost { namespace relations {
+
+// class:  StatCounter
+// desc:   relaxed atomic event count; shared by every thread
+//
+class StatCounter
+{
+  private :
+    std::atomic<uint64_t>  _n ;
+
+  public  :
+                   StatCounter() : _n( 0 ) {}
+
+    void           add( uint64_t n ) { _n.fetch_add( n, std::memory_order_relaxed ) ; }
+    uint64_t       get() const { return _n.load( std::memory_order_relaxed ) ; }
+    void           reset() { _n.store( 0, std::memory_order_relaxed ) ; }
+} ; // class StatCounter
+
+// class:  StatTally
+// desc:   counts locally and adds the total to a StatCounter once, when the
+//         scope ends; for loops that would otherwise hit the atomic per step
+//
+class StatTally
+{
+  private :
+    StatCounter   &_counter ;
+    uint64_t       _n ;
+
+  public  :
+    explicit       StatTally( StatCounter &counter_ ) : _counter( counter_ ), _n( 0 ) {}
+                  ~StatTally() { _counter.add( _n ) ; }
+
+    void           operator++ () { _n++ ; }
+    void           operator+= ( uint64_t n ) { _n += n ; }
+} ; // class StatTally
+
+// struct: NullTally
+// desc:   what BOOST_RELATIONS_TALLY declares when stats are compiled out
+//
+struct NullTally
+{
+  void             operator++ () {}
+  void             operator+= ( uint64_t ) {}
+} ; // struct NullTally
+
+// struct: Histogram
+// desc:   a plain copy of a LatencyHistogram.  bucket b counts samples in
+//         [2^b, 2^(b+1)) nanoseconds (bucket 0 also holds 0)
+//
+struct Histogram
+{
+  static const uint32_t buckets = 40 ;
+
+  uint64_t         count[buckets] ;
+  uint64_t         samples ;
+  uint64_t         total_ns ;
+
+                   Histogram() : samples( 0 ), total_ns( 0 ) { for (uint32_t b = 0; b < buckets; b++) count[b] = 0 ; }
+
+  double           mean_ns() const { return samples ? (double)total_ns / samples : 0.0 ; }
+
+  // upper bound of the bucket holding the 'p' quantile (0 < p <= 1)
+  uint64_t         quantile_ns( double p ) const
+                   {
+                     uint64_t  want = (uint64_t)(p * samples + 0.5) ;
+                     uint64_t  seen = 0 ;
+                     for (uint32_t b = 0; b < buckets; b++)
+                     {
+                       seen += count[b] ;
+                       if (seen >= want && seen != 0)
+                         return ((uint64_t)2 << b) - 1 ;
+                     }
+                     return 0 ;
+                   }
+} ; // struct Histogram
+
+// class:  LatencyHistogram
+// desc:   log2-bucketed latencies, recorded lock-free
+//
+class LatencyHistogram
+{
+  private :
+    std::atomic<uint64_t>  _count[Histogram::buckets] ;
+    std::atomic<uint64_t>  _total_ns ;
+
+  public  :
+                   LatencyHistogram() { reset() ; }
+
+    void           record( uint64_t ns )
+                   {
+                     uint32_t  b = 0 ;
+                     while ((ns >> (b + 1)) != 0 && b + 1 < Histogram::buckets)
+                       b++ ;
+                     _count[b].fetch_add( 1, std::memory_order_relaxed ) ;
+                     _total_ns.fetch_add( ns, std::memory_order_relaxed ) ;
+                   }
+    void           copy( Histogram &h ) const
+                   {
+                     h.samples  = 0 ;
+                     h.total_ns = _total_ns.load( std::memory_order_relaxed ) ;
+                     for (uint32_t b = 0; b < Histogram::buckets; b++)
+                     {
+                       h.count[b]  = _count[b].load( std::memory_order_relaxed ) ;
+                       h.samples  += h.count[b] ;
+                     }
+                   }
+    void           reset()
+                   {
+                     for (uint32_t b = 0; b < Histogram::buckets; b++)
+                       _count[b].store( 0, std::memory_order_relaxed ) ;
+                     _total_ns.store( 0, std::memory_order_relaxed ) ;
+                   }
+} ; // class LatencyHistogram
+
+// class:  ScopedTimer
+// desc:   records the lifetime of the enclosing scope into a histogram
+//
+class ScopedTimer
+{
+  private :
+    typedef std::chrono::steady_clock  Clock ;
+
+    LatencyHistogram   &_hist ;
+    Clock::time_point   _start ;
+
+  public  :
+    explicit       ScopedTimer( LatencyHistogram &hist_ ) : _hist( hist_ ), _start( Clock::now() ) {}
+                  ~ScopedTimer()
+                   {
+                     _hist.record( (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>( Clock::now() - _start ).count() ) ;
+                   }
+} ; // class ScopedTimer
+
+// struct: StatsSnapshot
+// desc:   plain copy of the process-wide counters, cheap to take and to ship
+//
+struct StatsSnapshot
+{
+  uint64_t         gets ;              // EntityMgr::get calls
+  uint64_t         creates ;           // entities created by get()
+  uint64_t         links ;             // Entity::link calls
+  uint64_t         links_added ;       // ... that added a link
+  uint64_t         unlinks ;           // links removed
+  uint64_t         hub_promotions ;    // relations that grew a hash index
+  uint64_t         meta_writes ;       // meta values added
+  uint64_t         reciprocal_calls ;  // link_with_reciprocals calls
+  uint64_t         reciprocal_links ;  // links they made, the original included
+  uint64_t         traversals ;        // traverse() calls
+  uint64_t         nodes_visited ;     // nodes they reported
+  uint64_t         path_queries ;      // find_path calls
+  uint64_t         path_nodes ;        // entities those searches reached
+  uint64_t         log_records ;       // change log records appended
+  uint64_t         log_batches ;       // batches written to the log
+  uint64_t         log_syncs ;         // fsyncs; commits that shared one count once
+
+  Histogram        get ;
+  Histogram        link ;
+  Histogram        meta ;
+  Histogram        reciprocal ;
+  Histogram        traversal ;
+  Histogram        path ;
+  Histogram        log_sync ;
+} ; // struct StatsSnapshot
+
+// class:  Stats
+// desc:   process-wide hot path statistics, fed by the BOOST_RELATIONS_COUNT
+//         and BOOST_RELATIONS_TIME hooks.  with BOOST_RELATIONS_STATS at 0
+//         nothing writes to it
+//
+class Stats
+{
+  public  :
+    StatCounter       gets ;
+    StatCounter       creates ;
+    StatCounter       links ;
+    StatCounter       links_added ;
+    StatCounter       unlinks ;
+    StatCounter       hub_promotions ;
+    StatCounter       meta_writes ;
+    StatCounter       reciprocal_calls ;
+    StatCounter       reciprocal_links ;
+    StatCounter       traversals ;
+    StatCounter       nodes_visited ;
+    StatCounter       path_queries ;
+    StatCounter       path_nodes ;
+    StatCounter       log_records ;
+    StatCounter       log_batches ;
+    StatCounter       log_syncs ;
+
+    LatencyHistogram  get_ns ;
+    LatencyHistogram  link_ns ;
+    LatencyHistogram  meta_ns ;
+    LatencyHistogram  reciprocal_ns ;
+    LatencyHistogram  traversal_ns ;
+    LatencyHistogram  path_ns ;
+    LatencyHistogram  log_sync_ns ;
+
+    static Stats     &global()
+                      {
+                        static Stats  s ;
+                        return s ;
+                      }
+    static bool       enabled() { return BOOST_RELATIONS_STATS >= 1 ; }
+    static bool       timed()   { return BOOST_RELATIONS_STATS >= 2 ; }
+
+    void              snapshot( StatsSnapshot &out ) const
+                      {
+                        out.gets             = gets.get() ;
+                        out.creates          = creates.get() ;
+                        out.links            = links.get() ;
+                        out.links_added      = links_added.get() ;
+                        out.unlinks          = unlinks.get() ;
+                        out.hub_promotions   = hub_promotions.get() ;
+                        out.meta_writes      = meta_writes.get() ;
+                        out.reciprocal_calls = reciprocal_calls.get() ;
+                        out.reciprocal_links = reciprocal_links.get() ;
+                        out.traversals       = traversals.get() ;
+                        out.nodes_visited    = nodes_visited.get() ;
+                        out.path_queries     = path_queries.get() ;
+                        out.path_nodes       = path_nodes.get() ;
+                        out.log_records      = log_records.get() ;
+                        out.log_batches      = log_batches.get() ;
+                        out.log_syncs        = log_syncs.get() ;
+                        get_ns.copy( out.get ) ;
+                        link_ns.copy( out.link ) ;
+                        meta_ns.copy( out.meta ) ;
+                        reciprocal_ns.copy( out.reciprocal ) ;
+                        traversal_ns.copy( out.traversal ) ;
+                        path_ns.copy( out.path ) ;
+                        log_sync_ns.copy( out.log_sync ) ;
+                      }
+    void              reset()
+                      {
+                        StatCounter  *c[] = { &gets, &creates, &links, &links_added, &unlinks, &hub_promotions, &meta_writes,
+                                              &reciprocal_calls, &reciprocal_links, &traversals, &nodes_visited,
+                                              &path_queries, &path_nodes, &log_records, &log_batches, &log_syncs } ;
+                        for (size_t i = 0; i < sizeof(c) / sizeof(c[0]); i++)
+                          c[i]->reset() ;
+                        get_ns.reset() ;
+                        link_ns.reset() ;
+                        meta_ns.reset() ;
+                        reciprocal_ns.reset() ;
+                        traversal_ns.reset() ;
+                        path_ns.reset() ;
+                        log_sync_ns.reset() ;
+                      }
+} ; // class Stats
+
+// struct: PopulationStats
+// desc:   shape and footprint of one EntityMgr, from EntityMgr::population_stats().
+//         degree[b] counts entities whose link count (all relations) lies in
+//         [2^b, 2^(b+1)); degree[0] also holds isolated entities.  byte
+//         figures count container capacity plus an estimate of per-node
+//         overhead for the hashed and tree containers
+//
+struct PopulationStats
+{
+  static const uint32_t degree_buckets = 32 ;
+
+  uint64_t         entities ;
+  uint64_t         relation_types ;    // (entity, relation) pairs
+  uint64_t         links ;
+  uint64_t         meta_values ;
+  uint64_t         hubs ;              // relations with a hash index
+  uint64_t         degree[degree_buckets] ;
+  uint64_t         max_degree ;
+  uint32_t         max_degree_id ;     // the entity with max_degree
+
+  uint64_t         entity_bytes ;      // the slab
+  uint64_t         id_index_bytes ;
+  uint64_t         link_bytes ;        // relation maps and target vectors
+  uint64_t         hub_bytes ;
+  uint64_t         meta_bytes ;        // pairs that outgrew the inline buffer
+  uint64_t         meta_index_bytes ;
+  uint64_t         value_pool_bytes ;  // interned meta values, shared by every EntityMgr
+
+                   PopulationStats() { clear() ; }
+
+  void             clear()
+                   {
+                     entities = relation_types = links = meta_values = hubs = max_degree = 0 ;
+                     max_degree_id = 0 ;
+                     entity_bytes = id_index_bytes = link_bytes = hub_bytes = meta_bytes = meta_index_bytes = 0 ;
+                     value_pool_bytes = 0 ;
+                     for (uint32_t b = 0; b < degree_buckets; b++)
+                       degree[b] = 0 ;
+                   }
+  void             add_degree( uint64_t d, uint32_t id )
+                   {
+                     uint32_t  b = 0 ;
+                     while ((d >> (b + 1)) != 0 && b + 1 < degree_buckets)
+                       b++ ;
+                     degree[b]++ ;
+                     if (d > max_degree)
+                     {
+                       max_degree    = d ;
+                       max_degree_id = id ;
+                     }
+                   }
+  uint64_t         total_bytes() const
+                   {
+                     return entity_bytes + id_index_bytes + link_bytes + hub_bytes + meta_bytes + meta_index_bytes
+                          + value_pool_bytes ;
+                   }
+  double           bytes_per_entity() const { return entities ? (double)total_bytes() / entities : 0.0 ; }
+} ; // struct PopulationStats
+
+// rough per-node costs of the node-based standard containers
+const size_t  hash_node_bytes = 2 * sizeof(void*) + sizeof(size_t) ;
+const size_t  tree_node_bytes = 4 * sizeof(void*) ;
+
+// heap bytes behind a string; 0 while it fits the small-string buffer
+inline size_t heap_bytes( const std::string &s )
+{
+  const char  *p = s.data() ;
+  bool         inside = (p >= (const char*)&s) && (p < (const char*)(&s + 1)) ;
+  return inside ? 0 : s.capacity() + 1 ;
+} // :: heap_bytes
+
+}} ; // namespace
+
+#endif
@@ -0,0 +1,64 @@
+/*!
+  @file       string_ref.hpp
+  @brief      Non-owning string reference
+
+  @author     Robert McInnis
+  @date       september 21, 2016
+  @par        copyright (c) 2016 Solid ICE Technologies, Inc.  All rights reserved.
+
+  Distributed under the Boost Software License, Version 1.0. (See accompanying
+  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+*/
+#ifndef STRING_REF_HPP
+#define STRING_REF_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace boost { namespace relations {
+
+// struct: StringRef
+// desc:   pointer + length into storage owned elsewhere (a snapshot's string
+//         pool, a loader's read buffer).  not NUL terminated
+//
+struct StringRef
+{
+  const char      *data ;
+  size_t           size ;
+
+                   StringRef() : data( "" ), size( 0 ) {}
+                   StringRef( const char *data_, size_t size_ ) : data( data_ ), size( size_ ) {}
+                   StringRef( const std::string &s ) : data( s.data() ), size( s.size() ) {}
+
+  bool             empty() const { return size == 0 ; }
+  const char      *begin() const { return data ; }
+  const char      *end()   const { return data + size ; }
+  char             operator[] ( size_t i ) const { return data[i] ; }
+  std::string      str() const { return std::string( data, size ) ; }
+
+  bool             operator== ( const StringRef &o ) const
+                   {
+                     return size == o.size && (size == 0 || memcmp( data, o.data, size ) == 0) ;
+                   }
+  bool             operator!= ( const StringRef &o ) const { return !(*this == o) ; }
+} ; // struct StringRef
+
+// struct: StringRefHash
+// desc:   FNV-1a over the referenced bytes, for hashing without a copy
+//
+struct StringRefHash
+{
+  size_t           operator() ( const StringRef &s ) const
+                   {
+                     uint64_t  h = 14695981039346656037ull ;
+                     for (size_t i = 0; i < s.size; i++)
+                       h = (h ^ (uint8_t)s.data[i]) * 1099511628211ull ;
+                     return (size_t)h ;
+                   }
+} ; // struct StringRefHash
+
+}} ; // namespace
+
+#endif
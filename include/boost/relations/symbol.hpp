@@ -0,0 +1,241 @@
+/*!
+  @file       symbol.hpp
+  @brief      Interned symbol (relation type / meta key) definitions
+
+  @author     Robert McInnis
+  @date       september 21, 2016
+  @par        copyright (c) 2016 Solid ICE Technologies, Inc.  All rights reserved.
+
+  Distributed under the Boost Software License, Version 1.0. (See accompanying
+  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+*/
+#ifndef SYMBOL_HPP
+#define SYMBOL_HPP
+
+#include <cstddef>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/relations/stats.hpp>
+
+namespace boost { namespace relations {
+
+// class:  SymbolTable
+// desc:   interns strings into small, dense integer ids.  names are stored
+//         append-only in fixed chunks that never move, and the id lookup is
+//         an open-addressed table of ids, so find(), name() and size() take
+//         no lock: intern() alone locks, publishing each name before its id
+//         becomes visible.  a grown lookup table or chunk directory replaces
+//         the old one, which is kept until the table is destroyed since a
+//         reader may still hold it
+//
+class SymbolTable
+{
+  private :
+    static const uint32_t    chunk_shift = 10 ;
+    static const uint32_t    chunk_size  = 1u << chunk_shift ;
+
+    struct Lookup
+    {
+      uint32_t                 mask ;
+      std::atomic<uint32_t>   *slots ;   // id + 1, 0 for empty
+
+                               Lookup( uint32_t capacity ) : mask( capacity - 1 ), slots( new std::atomic<uint32_t>[capacity] )
+                               {
+                                 for (uint32_t i = 0; i < capacity; i++)
+                                   slots[i].store( 0, std::memory_order_relaxed ) ;
+                               }
+                              ~Lookup() { delete [] slots ; }
+    } ;
+
+    std::atomic<uint32_t>       _size ;
+    std::atomic<std::string**>  _chunks ;     // chunk directory
+    uint32_t                    _chunk_cap ;  // directory entries
+    std::atomic<Lookup*>        _lookup ;
+    std::vector<std::string**>  _old_chunks ;
+    std::vector<Lookup*>        _old_lookups ;
+    std::mutex                  _lock ;       // intern() only
+
+                             SymbolTable( const SymbolTable & ) ;
+    SymbolTable             &operator= ( const SymbolTable & ) ;
+
+    static const std::string &none()
+                             {
+                               static const std::string  s ;
+                               return s ;
+                             }
+    const std::string       &at( uint32_t id ) const
+                             {
+                               return _chunks.load( std::memory_order_acquire )[id >> chunk_shift][id & (chunk_size - 1)] ;
+                             }
+    uint32_t                 find( const Lookup &l, const std::string &s, size_t h ) const
+                             {
+                               for (uint32_t i = (uint32_t)h & l.mask; ; i = (i + 1) & l.mask)
+                               {
+                                 uint32_t  v = l.slots[i].load( std::memory_order_acquire ) ;
+                                 if (v == 0)
+                                   return npos ;
+                                 if (at( v - 1 ) == s)
+                                   return v - 1 ;
+                               }
+                             }
+    static void              place( Lookup &l, uint32_t id, size_t h )
+                             {
+                               uint32_t  i = (uint32_t)h & l.mask ;
+                               while (l.slots[i].load( std::memory_order_relaxed ) != 0)
+                                 i = (i + 1) & l.mask ;
+                               l.slots[i].store( id + 1, std::memory_order_release ) ;
+                             }
+    // room for name 'id', growing the directory and adding a chunk as needed
+    std::string             &slot( uint32_t id )
+                             {
+                               uint32_t       c   = id >> chunk_shift ;
+                               std::string  **dir = _chunks.load( std::memory_order_relaxed ) ;
+                               if (c >= _chunk_cap)
+                               {
+                                 uint32_t       cap  = _chunk_cap ? _chunk_cap * 2 : 16 ;
+                                 std::string  **grown = new std::string*[cap]() ;
+                                 for (uint32_t i = 0; i < _chunk_cap; i++)
+                                   grown[i] = dir[i] ;
+                                 if (dir != nullptr)
+                                   _old_chunks.push_back( dir ) ;
+                                 _chunk_cap = cap ;
+                                 _chunks.store( grown, std::memory_order_release ) ;
+                                 dir = grown ;
+                               }
+                               if (dir[c] == nullptr)
+                                 dir[c] = new std::string[chunk_size] ;
+                               return dir[c][id & (chunk_size - 1)] ;
+                             }
+
+  public  :
+    static const uint32_t    npos = 0xffffffff ;
+
+                             SymbolTable() : _size( 0 ), _chunks( nullptr ), _chunk_cap( 0 ), _lookup( new Lookup( 64 )) {}
+                            ~SymbolTable()
+                             {
+                               std::string  **dir = _chunks.load() ;
+                               for (uint32_t i = 0; i < _chunk_cap; i++)
+                                 delete [] dir[i] ;
+                               delete [] dir ;
+                               for (size_t i = 0; i < _old_chunks.size(); i++)
+                                 delete [] _old_chunks[i] ;
+                               delete _lookup.load() ;
+                               for (size_t i = 0; i < _old_lookups.size(); i++)
+                                 delete _old_lookups[i] ;
+                             }
+
+    uint32_t                 intern( const std::string &s )
+                             {
+                               size_t    h  = std::hash<std::string>()( s ) ;
+                               uint32_t  id = find( *_lookup.load( std::memory_order_acquire ), s, h ) ;
+                               if (id != npos)
+                                 return id ;
+
+                               std::lock_guard<std::mutex>  guard( _lock ) ;
+                               Lookup  *l = _lookup.load( std::memory_order_relaxed ) ;
+                               id = find( *l, s, h ) ;
+                               if (id != npos)
+                                 return id ;
+
+                               id = _size.load( std::memory_order_relaxed ) ;
+                               slot( id ) = s ;
+                               _size.store( id + 1, std::memory_order_release ) ;
+
+                               // at most half full
+                               if ((uint64_t)(id + 1) * 2 > (uint64_t)l->mask + 1)
+                               {
+                                 Lookup  *grown = new Lookup( (l->mask + 1) * 2 ) ;
+                                 for (uint32_t i = 0; i < id; i++)
+                                   place( *grown, i, std::hash<std::string>()( at( i ))) ;
+                                 place( *grown, id, h ) ;
+                                 _old_lookups.push_back( l ) ;
+                                 _lookup.store( grown, std::memory_order_release ) ;
+                               }
+                               else
+                                 place( *l, id, h ) ;
+                               return id ;
+                             }
+    uint32_t                 find( const std::string &s ) const
+                             {
+                               return find( *_lookup.load( std::memory_order_acquire ), s, std::hash<std::string>()( s )) ;
+                             }
+    // the empty string for an id never handed out, npos included
+    const std::string       &name( uint32_t id ) const
+                             {
+                               if (id >= size())
+                                 return none() ;
+                               return at( id ) ;
+                             }
+    uint32_t                 size() const { return _size.load( std::memory_order_acquire ) ; }
+    // names, their chunks and the live lookup table; retired tables aside
+    size_t                   memory_bytes() const
+                             {
+                               uint32_t  n      = size() ;
+                               size_t    chunks = (n + chunk_size - 1) >> chunk_shift ;
+                               size_t    bytes  = chunks * (sizeof(std::string*) + chunk_size * sizeof(std::string)) +
+                                                  (_lookup.load( std::memory_order_acquire )->mask + 1) * sizeof(uint32_t) ;
+                               for (uint32_t i = 0; i < n; i++)
+                                 bytes += heap_bytes( at( i )) ;
+                               return bytes ;
+                             }
+} ; // class SymbolTable
+
+// class:  Symbol
+// desc:   small integer handle to an interned string.  each Tag gets its own
+//         table so relation types and meta keys use separate, dense id ranges.
+//         string constructors are explicit; interning is never silent
+//
+template <typename Tag>
+class Symbol
+{
+  private :
+    uint32_t       _id ;
+
+  public  :
+                   Symbol() : _id( SymbolTable::npos ) {}
+    explicit       Symbol( uint32_t id_ ) : _id( id_ ) {}
+    explicit       Symbol( const std::string &name_ ) : _id( table().intern( name_ )) {}
+    explicit       Symbol( const char *name_ ) : _id( table().intern( name_ )) {}
+
+    static SymbolTable &table()
+                   {
+                     static SymbolTable  t ;
+                     return t ;
+                   }
+
+    // non-interning lookup; returns an invalid symbol if 'name_' was never seen
+    static Symbol  find( const std::string &name_ ) { return Symbol( table().find( name_ )) ; }
+
+    uint32_t       id() const { return _id ; }
+    bool           valid() const { return _id != SymbolTable::npos ; }
+    const std::string &str() const { return table().name( _id ) ; }
+
+    bool           operator== ( const Symbol &o ) const { return _id == o._id ; }
+    bool           operator!= ( const Symbol &o ) const { return _id != o._id ; }
+    bool           operator<  ( const Symbol &o ) const { return _id <  o._id ; }
+} ; // class Symbol
+
+template <typename Tag>
+struct SymbolHash
+{
+  size_t           operator() ( const Symbol<Tag> &s ) const { return s.id() ; }
+} ; // struct SymbolHash
+
+struct RelationTag {} ;
+struct MetaTag     {} ;
+struct ValueTag    {} ;
+
+// meta values are interned as well: the pool holds each distinct string
+// once, however many entities carry it, and entities compare ids
+typedef Symbol<RelationTag>    RelationType ;
+typedef Symbol<MetaTag>        MetaKey ;
+typedef Symbol<ValueTag>       MetaValue ;
+
+}} ; // namespace
+
+#endif
@@ -0,0 +1,188 @@
+/*!
+  @file       thread_pool.hpp
+  @brief      Fixed-size worker pool for batch queries
+
+  @author     Robert McInnis
+  @date       september 21, 2016
+  @par        copyright (c) 2016 Solid ICE Technologies, Inc.  All rights reserved.
+
+  Distributed under the Boost Software License, Version 1.0. (See accompanying
+  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+*/
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace boost { namespace relations {
+
+// class:  ThreadPool
+// desc:   'size()' participants: size() - 1 parked worker threads plus the
+//         calling thread.  run() hands the same job to every participant and
+//         returns when all are done; parallel_for() layers dynamic chunked
+//         scheduling on top, so fast workers keep taking chunks from slow ones.
+//         an exception thrown by a participant is rethrown from run() once
+//         every participant has finished
+//
+class ThreadPool
+{
+  private :
+    std::vector<std::thread>           _workers ;
+    std::mutex                         _mutex ;
+    std::mutex                         _run_mutex ;  // one run() at a time
+    std::condition_variable            _wake ;
+    std::condition_variable            _done ;
+    std::function<void(unsigned)>      _job ;
+    uint64_t                           _generation ;
+    unsigned                           _pending ;
+    bool                               _quit ;
+    std::exception_ptr                 _error ;      // first thrown by this run()
+
+                   ThreadPool( const ThreadPool & ) ;
+    ThreadPool    &operator= ( const ThreadPool & ) ;
+
+    void           worker( unsigned index )
+                   {
+                     uint64_t  seen = 0 ;
+                     for (;;)
+                     {
+                       std::function<void(unsigned)>  job ;
+                       {
+                         std::unique_lock<std::mutex>  lock( _mutex ) ;
+                         _wake.wait( lock, [&]{ return _quit || _generation != seen ; } ) ;
+                         if (_quit)
+                           return ;
+                         seen = _generation ;
+                         job  = _job ;
+                       }
+
+                       std::exception_ptr  error ;
+                       try
+                       {
+                         job( index ) ;
+                       }
+                       catch (...)
+                       {
+                         error = std::current_exception() ;
+                       }
+
+                       std::lock_guard<std::mutex>  lock( _mutex ) ;
+                       if (error && !_error)
+                         _error = error ;
+                       if (--_pending == 0)
+                         _done.notify_one() ;
+                     }
+                   }
+
+  public  :
+    // 'threads' == 0 uses std::thread::hardware_concurrency()
+    explicit       ThreadPool( unsigned threads = 0 ) : _generation( 0 ), _pending( 0 ), _quit( false )
+                   {
+                     if (threads == 0)
+                       threads = std::thread::hardware_concurrency() ;
+                     if (threads == 0)
+                       threads = 1 ;
+                     for (unsigned i = 1; i < threads; i++)
+                       _workers.push_back( std::thread( &ThreadPool::worker, this, i )) ;
+                   }
+                  ~ThreadPool()
+                   {
+                     {
+                       std::lock_guard<std::mutex>  lock( _mutex ) ;
+                       _quit = true ;
+                     }
+                     _wake.notify_all() ;
+                     for (size_t i = 0; i < _workers.size(); i++)
+                       _workers[i].join() ;
+                   }
+
+    unsigned       size() const { return (unsigned)_workers.size() + 1 ; }
+
+    // job( participant ) runs once on every participant; participant 0 is
+    // the calling thread.  if any throw, the first exception is rethrown
+    // after all have returned, since they share the caller's stack
+    void           run( const std::function<void(unsigned)> &job )
+                   {
+                     std::lock_guard<std::mutex>  serial( _run_mutex ) ;
+                     if (_workers.empty())
+                     {
+                       job( 0 ) ;
+                       return ;
+                     }
+                     {
+                       std::lock_guard<std::mutex>  lock( _mutex ) ;
+                       _job     = job ;
+                       _pending = (unsigned)_workers.size() ;
+                       _generation++ ;
+                     }
+                     _wake.notify_all() ;
+
+                     std::exception_ptr  error ;
+                     try
+                     {
+                       job( 0 ) ;
+                     }
+                     catch (...)
+                     {
+                       error = std::current_exception() ;
+                     }
+
+                     std::unique_lock<std::mutex>  lock( _mutex ) ;
+                     _done.wait( lock, [&]{ return _pending == 0 ; } ) ;
+                     _job = nullptr ;
+                     if (!error)
+                       error = _error ;
+                     _error = nullptr ;
+                     lock.unlock() ;
+                     if (error)
+                       std::rethrow_exception( error ) ;
+                   }
+
+    // fn( participant, begin, end ) over [0, count) in chunks of 'grain'.
+    // once a chunk throws no new chunks start, and run() rethrows
+    template <typename F>
+    void           parallel_for( size_t count, size_t grain, F fn )
+                   {
+                     std::atomic<size_t>  next( 0 ) ;
+                     if (grain == 0)
+                       grain = 1 ;
+                     run( [&]( unsigned participant )
+                          {
+                            for (;;)
+                            {
+                              size_t  begin = next.fetch_add( grain ) ;
+                              if (begin >= count)
+                                return ;
+                              size_t  end = (begin + grain < count) ? begin + grain : count ;
+                              try
+                              {
+                                fn( participant, begin, end ) ;
+                              }
+                              catch (...)
+                              {
+                                next.store( count ) ;
+                                throw ;
+                              }
+                            }
+                          }) ;
+                   }
+
+    // process-wide pool sized to the machine
+    static ThreadPool &shared()
+                   {
+                     static ThreadPool  pool ;
+                     return pool ;
+                   }
+} ; // class ThreadPool
+
+}} ; // namespace
+
+#endif
@@ -0,0 +1,655 @@
+/*!
+  @file       traversal.hpp
+  @brief      Iterative relation traversal engine
+
+  @author     Robert McInnis
+  @date       september 21, 2016
+  @par        copyright (c) 2016 Solid ICE Technologies, Inc.  All rights reserved.
+
+  Distributed under the Boost Software License, Version 1.0. (See accompanying
+  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+*/
+#ifndef TRAVERSAL_HPP
+#define TRAVERSAL_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <boost/relations/entity.hpp>
+#include <boost/relations/packed_path.hpp>
+#include <boost/relations/span.hpp>
+#include <boost/relations/stats.hpp>
+#include <boost/relations/thread_pool.hpp>
+#include <boost/relations/visited.hpp>
+
+namespace boost { namespace relations {
+
+// enum:   Visit
+// desc:   visitor verdict for a newly reached node
+//
+enum class Visit { expand,   // report it and keep walking through it
+                   prune,    // report it, but don't walk through it
+                   stop } ;  // end the traversal now
+
+// enum:   Step
+// desc:   what a rule does with the node it reaches
+//
+enum class Step { walk,    // keep traversing through it
+                  stop } ; // report it, go no further (ie: spouse)
+
+// class:  TraversalSpec
+// desc:   the relations a traversal follows.  each rule maps a relation type
+//         to a path symbol (its step code is the rule's position), a Step
+//         policy and an optional cap on how often it may appear in one path.
+//         rules are compiled as they are added into a table indexed by
+//         relation id, so expanding a node is one pass over its links.
+//         a rule may also name its inverse relation (child for parent), which
+//         lets EntityMgr::find_path() search backwards from the target
+//
+class TraversalSpec
+{
+  public  :
+    static const uint8_t  max_rules = PackedPath::max_codes ;
+    static const uint8_t  none      = 0xff ;
+
+  private :
+    RelationType          _types[max_rules] ;
+    RelationType          _inverse[max_rules] ;   // invalid == not declared
+    char                  _chars[max_rules + 1] ;
+    uint8_t               _max_hops[max_rules] ;  // 0 == unlimited
+    uint16_t              _stop ;                 // bit per code
+    uint8_t               _count ;
+    std::vector<uint8_t>  _code_of ;              // relation id -> code, or none
+
+  public  :
+                   TraversalSpec() : _stop( 0 ), _count( 0 ) { _chars[0] = '\0' ; }
+
+    // rules beyond max_rules, or for a relation already followed, are ignored
+    TraversalSpec &follow( RelationType type_, char symbol, Step step = Step::walk, uint8_t max_hops = 0 )
+                   {
+                     if (_count == max_rules || !type_.valid() || code_of( type_ ) != none)
+                       return *this ;
+
+                     uint8_t  code = _count++ ;
+                     _types[code]    = type_ ;
+                     _chars[code]    = symbol ;
+                     _chars[_count]  = '\0' ;
+                     _max_hops[code] = max_hops ;
+                     if (step == Step::stop)
+                       _stop |= (uint16_t)(1 << code) ;
+
+                     if (type_.id() >= _code_of.size())
+                       _code_of.resize( type_.id() + 1, (uint8_t)none ) ;
+                     _code_of[type_.id()] = code ;
+                     return *this ;
+                   }
+    TraversalSpec &follow( const std::string &type_, char symbol, Step step = Step::walk, uint8_t max_hops = 0 )
+                   {
+                     return follow( RelationType( type_ ), symbol, step, max_hops ) ;
+                   }
+
+    // 'b' is-the 'inverse_' (of) 'a' whenever 'a' is-the 'type_' (of) 'b'.
+    // only meaningful if the links are kept reciprocal (ReciprocalMgr rules)
+    TraversalSpec &inverse( RelationType type_, RelationType inverse_ )
+                   {
+                     uint8_t  code = code_of( type_ ) ;
+                     if (code != none)
+                       _inverse[code] = inverse_ ;
+                     return *this ;
+                   }
+    TraversalSpec &inverse( const std::string &type_, const std::string &inverse_ )
+                   {
+                     return inverse( RelationType( type_ ), RelationType( inverse_ )) ;
+                   }
+
+    uint8_t        size() const { return _count ; }
+    RelationType   type( uint8_t code ) const { return _types[code] ; }
+    bool           stops( uint8_t code ) const { return (_stop >> code) & 1 ; }
+    uint8_t        max_hops( uint8_t code ) const { return _max_hops[code] ; }
+    RelationType   inverse( uint8_t code ) const { return _inverse[code] ; }
+    uint8_t        code_of( RelationType type_ ) const
+                   {
+                     return (type_.id() < _code_of.size()) ? _code_of[type_.id()] : none ;
+                   }
+
+    // every rule has an inverse and none is hop-capped, so a path can be
+    // searched from both ends
+    bool           reversible() const
+                   {
+                     for (uint8_t code = 0; code < _count; code++)
+                     {
+                       if (!_inverse[code].valid() || _max_hops[code] != 0)
+                         return false ;
+                     }
+                     return true ;
+                   }
+
+    // display characters for the step codes, usable with PackedPath::str()
+    const char    *chars() const { return _chars ; }
+
+    // the original family walk: parent/child/sibling, report spouses but
+    // don't cross them
+    static const TraversalSpec &family()
+                   {
+                     static TraversalSpec  spec = TraversalSpec().follow( "parent" , 'c' )
+                                                                 .follow( "child"  , 'p' )
+                                                                 .follow( "sibling", 's' )
+                                                                 .follow( "spouse" , 'S', Step::stop )
+                                                                 .inverse( "parent" , "child" )
+                                                                 .inverse( "child"  , "parent" )
+                                                                 .inverse( "sibling", "sibling" )
+                                                                 .inverse( "spouse" , "spouse" ) ;
+                     return spec ;
+                   }
+} ; // class TraversalSpec
+
+// struct: TraversalHit
+// desc:   a reached node and the path that reached it
+//
+template <typename Node>
+struct TraversalHit
+{
+  Node             node ;
+  PackedPath       path ;
+
+                   TraversalHit( Node node_, PackedPath path_ ) : node( node_ ), path( path_ ) {}
+} ; // struct TraversalHit
+
+// struct: GraphTraits
+// desc:   adapts a graph type to the engine: node_type, visited_type,
+//         expand() filling one Span of node_type per step code, and
+//         prepare() to size the visited set
+//
+template <typename Graph>
+struct GraphTraits ;
+
+// struct: EntityGraph
+// desc:   walk Entity objects directly through their links
+//
+struct EntityGraph {} ;
+
+template <>
+struct GraphTraits<EntityGraph>
+{
+  typedef Entity                 *node_type ;
+  typedef PointerSet<Entity>      visited_type ;
+
+  static void      expand( const EntityGraph &, Entity *e, const TraversalSpec &spec, Span<Entity*> *out )
+                   {
+                     RelationMap  &links = e->relations() ;
+                     for (RelationMap_iter it = links.begin(); it != links.end(); it++)
+                     {
+                       uint8_t  code = spec.code_of( (*it).first ) ;
+                       if (code != TraversalSpec::none && !(*it).second.empty())
+                         out[code] = Span<Entity*>( (*it).second.data(), (*it).second.data() + (*it).second.size() ) ;
+                     }
+                   }
+  static void      prepare( const EntityGraph &, visited_type & ) {}
+} ; // struct GraphTraits<EntityGraph>
+
+// struct: SlotGraph
+// desc:   walk the entities of one EntityMgr, tracking visited entities by
+//         their dense slot in an EpochSet.  resetting between queries is
+//         O(1) and nothing is hashed, at 4 bytes of scratch per entity
+//
+struct SlotGraph
+{
+  const EntityMgr  *mgr ;
+
+  explicit         SlotGraph( const EntityMgr &mgr_ ) : mgr( &mgr_ ) {}
+} ; // struct SlotGraph
+
+// struct: SlotVisited
+// desc:   EpochSet keyed by Entity::slot()
+//
+struct SlotVisited
+{
+  EpochSet         set ;
+
+  bool             insert( Entity *e ) { return set.insert( e->slot() ) ; }
+  void             clear() { set.clear() ; }
+} ; // struct SlotVisited
+
+template <>
+struct GraphTraits<SlotGraph>
+{
+  typedef Entity                 *node_type ;
+  typedef SlotVisited             visited_type ;
+
+  static void      expand( const SlotGraph &, Entity *e, const TraversalSpec &spec, Span<Entity*> *out )
+                   {
+                     GraphTraits<EntityGraph>::expand( EntityGraph(), e, spec, out ) ;
+                   }
+  static void      prepare( const SlotGraph &g, visited_type &visited ) { visited.set.resize( g.mgr->slots() ) ; }
+} ; // struct GraphTraits<SlotGraph>
+
+// class:  TraversalScratch
+// desc:   caller-owned working memory for traverse(); keep one per thread and
+//         reuse it so steady-state queries don't allocate
+//
+template <typename Graph>
+class TraversalScratch
+{
+  public  :
+    typedef typename GraphTraits<Graph>::node_type     node_type ;
+    typedef typename GraphTraits<Graph>::visited_type  visited_type ;
+
+    std::vector< TraversalHit<node_type> >  queue ;
+    visited_type                            visited ;
+} ; // class TraversalScratch
+
+// EntityScratch, SlotScratch, EntityHitVec and SlotHitVec are declared in entity.hpp
+typedef TraversalHit<Entity*>                 EntityHit ;
+typedef std::vector<EntityHit>::iterator      EntityHitVec_iter ;
+typedef TraversalHit<uint32_t>                SlotHit ;
+typedef std::vector<SlotHit>::iterator        SlotHitVec_iter ;
+
+// struct: RelationPath
+// desc:   result of EntityMgr::find_path(): the step codes from source to
+//         target and the path.size() + 1 entities they pass through
+//
+struct RelationPath
+{
+  PackedPath       path ;
+  EntityVec        nodes ;   // nodes[0] is the source
+
+  void             clear() { path = PackedPath() ; nodes.clear() ; }
+} ; // struct RelationPath
+
+// class:  PathScratch
+// desc:   caller-owned working memory for EntityMgr::find_path(); one side
+//         per search direction.  each side records, by slot, the neighbour
+//         toward its root and the path from that root, stamped in an
+//         EpochSet so reuse costs nothing to reset
+//
+class PathScratch
+{
+  public  :
+    struct Side
+    {
+      EpochSet                 seen ;
+      std::vector<uint32_t>    via ;      // slot -> slot one step nearer the root
+      std::vector<PackedPath>  path ;     // slot -> codes from the root, nearest first
+      std::vector<Entity*>     frontier ;
+      std::vector<Entity*>     next ;
+
+      void         reset( uint32_t slots )
+                   {
+                     seen.clear() ;
+                     seen.resize( slots ) ;
+                     if (via.size() < slots)
+                     {
+                       via.resize( slots ) ;
+                       path.resize( slots ) ;
+                     }
+                     frontier.clear() ;
+                     next.clear() ;
+                   }
+      void         reach( Entity *e, uint32_t via_, PackedPath path_ )
+                   {
+                     seen.insert( e->slot() ) ;
+                     via[e->slot()]  = via_ ;
+                     path[e->slot()] = path_ ;
+                     next.push_back( e ) ;
+                   }
+    } ;
+
+    Side           forward ;
+    Side           backward ;
+} ; // class PathScratch
+
+// func:   hop_count
+// desc:   occurrences of 'code' in 'path'
+//
+inline uint32_t hop_count( PackedPath path, uint8_t code )
+{
+  uint32_t  n = 0 ;
+  for (uint32_t i = 0; i < path.size(); i++)
+    n += (path.at( i ) == code) ;
+  return n ;
+} // :: hop_count
+
+// func:   traverse
+// desc:   breadth-first walk from 'root' following 'spec', at most
+//         'max_depth' steps (capped at PackedPath::max_steps).
+//         'visit( node, path )' is called once per reached node, shortest
+//         path first and, within a node's neighbours, in rule order.  the
+//         root itself is not reported
+//
+template <typename Graph, typename Visitor>
+void traverse( const Graph &g, typename GraphTraits<Graph>::node_type root, const TraversalSpec &spec,
+               TraversalScratch<Graph> &scratch, uint32_t max_depth, Visitor visit )
+{
+  typedef GraphTraits<Graph>                      traits ;
+  typedef typename traits::node_type              node_type ;
+
+  Span<node_type>  next[TraversalSpec::max_rules] ;
+  uint8_t          rules = spec.size() ;
+
+  BOOST_RELATIONS_TIME( traversal_ns ) ;
+  BOOST_RELATIONS_COUNT( traversals, 1 ) ;
+  BOOST_RELATIONS_TALLY( visited, nodes_visited ) ;
+
+  if (max_depth > PackedPath::max_steps)
+    max_depth = PackedPath::max_steps ;
+
+  scratch.queue.clear() ;
+  scratch.visited.clear() ;
+  traits::prepare( g, scratch.visited ) ;
+  scratch.visited.insert( root ) ;
+  scratch.queue.push_back( TraversalHit<node_type>( root, PackedPath() )) ;
+
+  for (size_t head = 0; head < scratch.queue.size(); head++)
+  {
+    // copy: the queue may reallocate below
+    TraversalHit<node_type>  from = scratch.queue[head] ;
+    if (from.path.size() >= max_depth)
+      continue ;
+
+    for (uint8_t code = 0; code < rules; code++)
+      next[code] = Span<node_type>() ;
+    traits::expand( g, from.node, spec, next ) ;
+
+    for (uint8_t code = 0; code < rules; code++)
+    {
+      if (next[code].empty())
+        continue ;
+      if (spec.max_hops( code ) != 0 && hop_count( from.path, code ) >= spec.max_hops( code ))
+        continue ;
+
+      PackedPath  path = from.path.push( code ) ;
+      for (const node_type *n = next[code].begin(); n != next[code].end(); n++)
+      {
+        if (scratch.visited.insert( *n ) == false)
+          continue ;
+        ++visited ;
+
+        Visit  v = visit( *n, path ) ;
+        if (v == Visit::stop)
+          return ;
+        if (v == Visit::expand && !spec.stops( code ))
+          scratch.queue.push_back( TraversalHit<node_type>( *n, path )) ;
+      }
+    }
+  }
+} // :: traverse
+
+template <typename Graph, typename Visitor>
+void traverse( const Graph &g, typename GraphTraits<Graph>::node_type root,
+               TraversalScratch<Graph> &scratch, uint32_t max_depth, Visitor visit )
+{
+  traverse( g, root, TraversalSpec::family(), scratch, max_depth, visit ) ;
+} // :: traverse
+
+//-----------------------------------------------------------------------------
+// Entity traversal members; defined here so entity.hpp stays engine-agnostic
+//
+
+template <typename Visitor>
+inline void Entity::find_relations( const TraversalSpec &spec, EntityScratch &scratch, uint32_t max_depth, Visitor visit )
+{
+  traverse( EntityGraph(), this, spec, scratch, max_depth, visit ) ;
+} // Entity :: find_relations
+
+template <typename Visitor>
+inline void Entity::find_relations( EntityScratch &scratch, uint32_t max_depth, Visitor visit )
+{
+  traverse( EntityGraph(), this, scratch, max_depth, visit ) ;
+} // Entity :: find_relations
+
+inline void Entity::find_relations( EntityHitVec &out, EntityScratch &scratch, uint32_t max_depth )
+{
+  out.clear() ;
+  find_relations( scratch, max_depth, [&out]( Entity *e, PackedPath path ) -> Visit
+                  {
+                    out.push_back( EntityHit( e, path )) ;
+                    return Visit::expand ;
+                  }) ;
+} // Entity :: find_relations
+
+inline void Entity::find_relations( EntityRelationMap &data, const std::string &path )
+{
+  EntityScratch  scratch ;
+  char           buf[PackedPath::max_steps + 1] ;
+
+  // entities already in 'data' are left alone and not walked through
+  find_relations( scratch, PackedPath::max_steps, [&]( Entity *e, PackedPath p ) -> Visit
+                  {
+                    if (data.find( e ) != data.end())
+                      return Visit::prune ;
+                    data.insert( EntityRelationMap_pair( e, path + p.str( TraversalSpec::family().chars(), buf ))) ;
+                    return Visit::expand ;
+                  }) ;
+} // Entity :: find_relations
+
+inline void Entity::find_relations( EntityRelationMap &data )
+{
+  find_relations( data, std::string() ) ;
+} // Entity :: find_relations
+
+//-----------------------------------------------------------------------------
+// EntityMgr traversal
+//
+
+inline void EntityMgr::find_relations( const std::vector<uint32_t> &sources, std::vector<EntityHitVec> &results,
+                                       const TraversalSpec &spec, uint32_t max_depth, ThreadPool &pool ) const
+{
+  // one scratch per participant, reused across its roots and freed with the
+  // batch.  PointerSet, not the slot-indexed EpochSet: its size follows the
+  // closures walked, not the population times the thread count
+  std::vector<EntityScratch>  scratch( pool.size() ) ;
+
+  results.resize( sources.size() ) ;
+  pool.parallel_for( sources.size(), 16, [&]( unsigned participant, size_t begin, size_t end )
+                     {
+                       EntityScratch  &s = scratch[participant] ;
+                       for (size_t i = begin; i < end; i++)
+                       {
+                         EntityHitVec  &out  = results[i] ;
+                         Entity        *root = find( sources[i] ) ;
+
+                         out.clear() ;
+                         if (root == nullptr)
+                           continue ;
+                         traverse( EntityGraph(), root, spec, s, max_depth, [&out]( Entity *e, PackedPath path ) -> Visit
+                                   {
+                                     out.push_back( EntityHit( e, path )) ;
+                                     return Visit::expand ;
+                                   }) ;
+                       }
+                     }) ;
+} // EntityMgr :: find_relations
+
+inline void EntityMgr::find_relations( uint32_t id, const TraversalSpec &spec, SlotHitVec &out, SlotScratch &scratch,
+                                       uint32_t max_depth ) const
+{
+  Entity  *root = find( id ) ;
+
+  out.clear() ;
+  if (root == nullptr)
+    return ;
+  traverse( SlotGraph( *this ), root, spec, scratch, max_depth, [&out]( Entity *e, PackedPath path ) -> Visit
+            {
+              out.push_back( SlotHit( e->slot(), path )) ;
+              return Visit::expand ;
+            }) ;
+} // EntityMgr :: find_relations
+
+inline void EntityMgr::find_relations( uint32_t id, SlotHitVec &out, SlotScratch &scratch, uint32_t max_depth ) const
+{
+  find_relations( id, TraversalSpec::family(), out, scratch, max_depth ) ;
+} // EntityMgr :: find_relations
+
+inline void EntityMgr::find_relations( const std::vector<uint32_t> &sources, std::vector<EntityHitVec> &results,
+                                       uint32_t max_depth ) const
+{
+  find_relations( sources, results, TraversalSpec::family(), max_depth, ThreadPool::shared() ) ;
+} // EntityMgr :: find_relations
+
+inline bool EntityMgr::find_path( uint32_t from, uint32_t to, const TraversalSpec &spec, RelationPath &out,
+                                  PathScratch &scratch, uint32_t max_depth ) const
+{
+  typedef PathScratch::Side  Side ;
+
+  Entity    *a = find( from ) ;
+  Entity    *b = find( to ) ;
+  Side      &f = scratch.forward ;
+  Side      &r = scratch.backward ;
+  uint8_t    rules = spec.size() ;
+  bool       two_sided = spec.reversible() ;
+
+  Span<Entity*>  next[TraversalSpec::max_rules] ;
+
+  // best meeting so far: the edge join_from -join_code-> join_to, with
+  // join_from reached forwards and join_to backwards
+  uint32_t   best = PackedPath::max_steps + 1 ;
+  uint32_t   join_from = 0 ;
+  uint32_t   join_to   = 0 ;
+  uint8_t    join_code = 0 ;
+
+  BOOST_RELATIONS_TIME( path_ns ) ;
+  BOOST_RELATIONS_COUNT( path_queries, 1 ) ;
+  BOOST_RELATIONS_TALLY( reached, path_nodes ) ;
+
+  out.clear() ;
+  if (a == nullptr || b == nullptr)
+    return false ;
+  if (a == b)
+  {
+    out.nodes.push_back( a ) ;
+    return true ;
+  }
+  if (max_depth > PackedPath::max_steps)
+    max_depth = PackedPath::max_steps ;
+
+  f.reset( slots() ) ;
+  r.reset( slots() ) ;
+  f.reach( a, a->slot(), PackedPath() ) ;
+  r.reach( b, b->slot(), PackedPath() ) ;
+  f.frontier.swap( f.next ) ;
+  r.frontier.swap( r.next ) ;
+
+  // level-synchronous: each round grows the smaller frontier by one level.
+  // a spouse-style stop rule may only be the final step into 'b', so forward
+  // nodes reached through one are never stamped, and the backward side uses
+  // stop rules only from 'b' itself.  once a round ends, any path not yet
+  // seen is longer than the two depths plus one
+  uint32_t   df = 0 ;
+  uint32_t   db = 0 ;
+  while (df + db < max_depth && best > df + db + 1)
+  {
+    if (f.frontier.empty() || (two_sided && r.frontier.empty()))
+      break ;
+
+    if (two_sided && r.frontier.size() < f.frontier.size())
+    {
+      for (size_t i = 0; i < r.frontier.size(); i++)
+      {
+        Entity      *v  = r.frontier[i] ;
+        PackedPath   pv = r.path[v->slot()] ;
+        for (uint8_t code = 0; code < rules; code++)
+        {
+          if (spec.stops( code ) && db != 0)
+            continue ;
+          EntityVec  *preds = v->relation( spec.inverse( code )) ;
+          if (preds == nullptr)
+            continue ;
+          for (EntityVec_iter it = preds->begin(); it != preds->end(); it++)
+          {
+            Entity  *u = (*it) ;
+            if (f.seen.contains( u->slot() ) && f.path[u->slot()].size() + 1 + db < best)
+            {
+              best      = f.path[u->slot()].size() + 1 + db ;
+              join_from = u->slot() ;
+              join_code = code ;
+              join_to   = v->slot() ;
+            }
+            if (!r.seen.contains( u->slot() ))
+              r.reach( u, v->slot(), pv.push( code )) ;
+          }
+        }
+      }
+      reached += r.next.size() ;
+      r.frontier.swap( r.next ) ;
+      r.next.clear() ;
+      db++ ;
+      continue ;
+    }
+
+    for (size_t i = 0; i < f.frontier.size(); i++)
+    {
+      Entity      *u  = f.frontier[i] ;
+      PackedPath   pu = f.path[u->slot()] ;
+
+      for (uint8_t code = 0; code < rules; code++)
+        next[code] = Span<Entity*>() ;
+      GraphTraits<EntityGraph>::expand( EntityGraph(), u, spec, next ) ;
+
+      for (uint8_t code = 0; code < rules; code++)
+      {
+        if (next[code].empty())
+          continue ;
+        if (spec.max_hops( code ) != 0 && hop_count( pu, code ) >= spec.max_hops( code ))
+          continue ;
+        for (Entity * const *n = next[code].begin(); n != next[code].end(); n++)
+        {
+          Entity  *v = (*n) ;
+          if (r.seen.contains( v->slot() ) && (!spec.stops( code ) || v == b) &&
+              df + 1 + r.path[v->slot()].size() < best)
+          {
+            best      = df + 1 + r.path[v->slot()].size() ;
+            join_from = u->slot() ;
+            join_code = code ;
+            join_to   = v->slot() ;
+          }
+          if (!spec.stops( code ) && !f.seen.contains( v->slot() ))
+            f.reach( v, u->slot(), pu.push( code )) ;
+        }
+      }
+    }
+    reached += f.next.size() ;
+    f.frontier.swap( f.next ) ;
+    f.next.clear() ;
+    df++ ;
+  }
+
+  if (best > max_depth)
+    return false ;
+
+  // forward half: walk 'via' back to 'a', then reverse
+  PackedPath  pf = f.path[join_from] ;
+  for (uint32_t s = join_from; ; s = f.via[s])
+  {
+    out.nodes.push_back( at_slot( s )) ;
+    if (s == a->slot())
+      break ;
+  }
+  std::reverse( out.nodes.begin(), out.nodes.end() ) ;
+
+  // the joining edge and the backward half, whose codes run nearest-first
+  PackedPath  pb = r.path[join_to] ;
+  out.path = pf.push( join_code ) ;
+  for (uint32_t i = pb.size(); i > 0; i--)
+    out.path = out.path.push( pb.at( i - 1 )) ;
+  for (uint32_t s = join_to; ; s = r.via[s])
+  {
+    out.nodes.push_back( at_slot( s )) ;
+    if (s == b->slot())
+      break ;
+  }
+  return true ;
+} // EntityMgr :: find_path
+
+inline bool EntityMgr::find_path( uint32_t from, uint32_t to, RelationPath &out, PathScratch &scratch,
+                                  uint32_t max_depth ) const
+{
+  return find_path( from, to, TraversalSpec::family(), out, scratch, max_depth ) ;
+} // EntityMgr :: find_path
+
+}} ; // namespace
+
+#include <boost/relations/closure_cache.hpp>
+
+#endif
@@ -0,0 +1,168 @@
+/*!
+  @file       visited.hpp
+  @brief      Reusable visited sets for traversals
+
+  @author     Robert McInnis
+  @date       september 21, 2016
+  @par        copyright (c) 2016 Solid ICE Technologies, Inc.  All rights reserved.
+
+  Distributed under the Boost Software License, Version 1.0. (See accompanying
+  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+*/
+#ifndef VISITED_HPP
+#define VISITED_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace boost { namespace relations {
+
+// class:  PointerSet
+// desc:   open-addressing set of pointers.  clear() only resets the slots
+//         that were used, so a set reused across traversals costs
+//         O(visited) per query and stops allocating once it has warmed up
+//
+template <typename T>
+class PointerSet
+{
+  private :
+    std::vector<T*>        _slots ;    // power-of-two size
+    std::vector<uint32_t>  _touched ;  // used slot positions
+
+    size_t         slot_of( T *p ) const
+                   {
+                     uint64_t  h = (uint64_t)(uintptr_t)p * 0x9E3779B97F4A7C15ull ;
+                     return (size_t)(h >> 32) & (_slots.size() - 1) ;
+                   }
+    void           grow()
+                   {
+                     std::vector<T*>  old ;
+                     old.swap( _slots ) ;
+                     _slots.assign( old.empty() ? 64 : old.size() * 2, nullptr ) ;
+                     _touched.clear() ;
+                     for (size_t i = 0; i < old.size(); i++)
+                     {
+                       if (old[i] != nullptr)
+                         insert( old[i] ) ;
+                     }
+                   }
+
+  public  :
+                   PointerSet() {}
+
+    size_t         size() const { return _touched.size() ; }
+
+    bool           contains( T *p ) const
+                   {
+                     if (_slots.empty())
+                       return false ;
+                     for (size_t i = slot_of( p ); _slots[i] != nullptr; i = (i + 1) & (_slots.size() - 1))
+                     {
+                       if (_slots[i] == p)
+                         return true ;
+                     }
+                     return false ;
+                   }
+    // returns false if 'p' was already present
+    bool           insert( T *p )
+                   {
+                     if ((_touched.size() + 1) * 2 > _slots.size())
+                       grow() ;
+                     size_t  i = slot_of( p ) ;
+                     for (; _slots[i] != nullptr; i = (i + 1) & (_slots.size() - 1))
+                     {
+                       if (_slots[i] == p)
+                         return false ;
+                     }
+                     _slots[i] = p ;
+                     _touched.push_back( (uint32_t)i ) ;
+                     return true ;
+                   }
+    void           clear()
+                   {
+                     for (size_t i = 0; i < _touched.size(); i++)
+                       _slots[_touched[i]] = nullptr ;
+                     _touched.clear() ;
+                   }
+} ; // class PointerSet
+
+// class:  IndexSet
+// desc:   dense bitmap over [0, n) for graphs with contiguous node indices.
+//         clear() resets only the words that were written
+//
+class IndexSet
+{
+  private :
+    std::vector<uint64_t>  _bits ;
+    std::vector<uint32_t>  _touched ;  // word positions
+
+  public  :
+                   IndexSet() {}
+
+    void           resize( size_t n )
+                   {
+                     if (_bits.size() * 64 < n)
+                       _bits.resize( (n + 63) / 64, 0 ) ;
+                   }
+    bool           contains( uint32_t i ) const { return (_bits[i >> 6] >> (i & 63)) & 1 ; }
+    bool           insert( uint32_t i )
+                   {
+                     uint64_t  &w = _bits[i >> 6] ;
+                     uint64_t   m = (uint64_t)1 << (i & 63) ;
+                     if (w & m)
+                       return false ;
+                     if (w == 0)
+                       _touched.push_back( i >> 6 ) ;
+                     w |= m ;
+                     return true ;
+                   }
+    void           clear()
+                   {
+                     for (size_t i = 0; i < _touched.size(); i++)
+                       _bits[_touched[i]] = 0 ;
+                     _touched.clear() ;
+                   }
+} ; // class IndexSet
+
+// class:  EpochSet
+// desc:   per-index stamp array over [0, n).  an index is present when its
+//         stamp equals the current epoch, so clear() is a single increment
+//         (plus a full wipe once every 2^32 - 1 clears)
+//
+class EpochSet
+{
+  private :
+    std::vector<uint32_t>  _stamps ;
+    uint32_t               _epoch ;
+
+  public  :
+                   EpochSet() : _epoch( 1 ) {}
+
+    void           resize( size_t n )
+                   {
+                     if (_stamps.size() < n)
+                       _stamps.resize( n, 0 ) ;
+                   }
+    bool           contains( uint32_t i ) const { return _stamps[i] == _epoch ; }
+    bool           insert( uint32_t i )
+                   {
+                     if (_stamps[i] == _epoch)
+                       return false ;
+                     _stamps[i] = _epoch ;
+                     return true ;
+                   }
+    void           clear()
+                   {
+                     if (++_epoch == 0)
+                     {
+                       std::fill( _stamps.begin(), _stamps.end(), 0 ) ;
+                       _epoch = 1 ;
+                     }
+                   }
+} ; // class EpochSet
+
+}} ; // namespace
+
+#endif
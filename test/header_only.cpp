@@ -0,0 +1,40 @@
+/*!
+  @file       header_only.cpp
+  @brief      second translation unit for the test program
+
+  @author     Robert McInnis
+  @date       september 21, 2016
+  @par        copyright (c) 2016 Solid ICE Technologies, Inc.  All rights reserved.
+
+  Distributed under the Boost Software License, Version 1.0. (See accompanying
+  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+*/
+
+// every public header again; anything defined non-inline in a header
+// shows up as a duplicate symbol when this links with simple_relations.cpp
+//
+#include <boost/relations/arena.hpp>
+#include <boost/relations/change_log.hpp>
+#include <boost/relations/closure_cache.hpp>
+#include <boost/relations/entity.hpp>
+#include <boost/relations/entity_index.hpp>
+#include <boost/relations/flat_map.hpp>
+#include <boost/relations/frozen_graph.hpp>
+#include <boost/relations/journal.hpp>
+#include <boost/relations/loader.hpp>
+#include <boost/relations/mapped_file.hpp>
+#include <boost/relations/meta_columns.hpp>
+#include <boost/relations/meta_index.hpp>
+#include <boost/relations/meta_set.hpp>
+#include <boost/relations/packed_path.hpp>
+#include <boost/relations/path_labeler.hpp>
+#include <boost/relations/reciprocal.hpp>
+#include <boost/relations/schema.hpp>
+#include <boost/relations/span.hpp>
+#include <boost/relations/spin_lock.hpp>
+#include <boost/relations/stats.hpp>
+#include <boost/relations/string_ref.hpp>
+#include <boost/relations/symbol.hpp>
+#include <boost/relations/thread_pool.hpp>
+#include <boost/relations/traversal.hpp>
+#include <boost/relations/visited.hpp>